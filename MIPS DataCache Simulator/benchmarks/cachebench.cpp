@@ -0,0 +1,149 @@
+/*
+ MIPS DataCache Simulator - cache library micro-benchmark
+
+ Runs a trace through the Cache of cachesim.h twice, once with a call to Access() per reference and once in
+ batches, and prints the throughput of each.  The valid references of the trace are decoded once into memory and
+ replayed until the requested number has been simulated, so only the cache model and the call overhead are
+ measured.  Both runs must agree on every result; their totals also match the simulator's --summary-only output
+ for the same trace and configuration when the trace is not replayed.
+
+ -------------------------------------
+ Compilation statement:
+ g++ -O2 -I.. -ocachebench.x cachebench.cpp
+
+ Usage:
+ ./cachebench.x ../testBig4.dat sets ways linesize [references] [batch]
+    (references defaults to one pass over the trace, batch to 4096)
+ -------------------------------------
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "traceparser.h"
+#include "cachesim.h"
+
+//What one run did, with a checksum over every result so the runs can be compared
+struct RunTotals
+{
+    size_t hits;
+    size_t misses;
+    size_t accesses;
+    unsigned long long checksum;
+};
+
+//Simulates targetRefs references of trace, batchSize at a time, through a new cache
+RunTotals RunCache(const CacheConfig & config, const std::vector<Ref> & trace, size_t targetRefs, size_t batchSize)
+{
+    Cache cache(config);
+    std::vector<RefResult> results(batchSize);
+    RunTotals totals = {0, 0, 0, 0};
+    size_t position = 0;
+    for (size_t done = 0; done < targetRefs; )
+    {
+        size_t count = std::min(std::min(batchSize, targetRefs - done), trace.size() - position);
+        if (cache.Access(trace.data() + position, count, results.data()) != count)
+        {
+            std::cerr << "Invalid reference in the trace\n";
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < count; ++i)
+            totals.checksum = totals.checksum * 31 + results[i].hit + results[i].memrefs * 7ULL + results[i].tag * 131ULL;
+        done += count;
+        position += count;
+        if (position == trace.size())
+            position = 0;
+    }
+    totals.hits = cache.Hits();
+    totals.misses = cache.Misses();
+    totals.accesses = cache.Accesses();
+    return totals;
+}
+
+//Runs one batch size and prints its throughput
+RunTotals TimeRun(const char *name, const CacheConfig & config, const std::vector<Ref> & trace, size_t targetRefs,
+                  size_t batchSize)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    RunTotals totals = RunCache(config, trace, targetRefs, batchSize);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << name << ": " << targetRefs << " references in " << elapsed.count() << " s ("
+              << (targetRefs / elapsed.count() / 1e6) << " M refs/s), " << totals.hits << " hits, "
+              << totals.misses << " misses, " << totals.accesses << " accesses\n";
+    return totals;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 5)
+    {
+        std::cerr << "Usage: " << argv[0] << " trace.dat sets ways linesize [references] [batch]\n";
+        return EXIT_FAILURE;
+    }
+
+    CacheConfig config = {strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), strtoull(argv[4], NULL, 10),
+                          POLICY_LRU, false, true, 0};
+    const char *problem = CheckCacheConfig(config);
+    if (problem != NULL)
+    {
+        std::cerr << "Invalid cache: " << problem << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream inDatFile(argv[1], std::ios::in | std::ios::binary);
+    if (!inDatFile)
+    {
+        std::cerr << "Failed to read data file.\n";
+        return EXIT_FAILURE;
+    }
+    std::ostringstream contents;
+    contents << inDatFile.rdbuf();
+    std::string text = contents.str();
+
+    //decode the valid references once, with the simulator's checks
+    std::vector<Ref> trace;
+    TraceFields fields;
+    const char *lineStart = text.data();
+    const char *textEnd = text.data() + text.size();
+    for (size_t lineNumber = 1; lineStart != textEnd; ++lineNumber)
+    {
+        const char *newline = static_cast<const char *>(memchr(lineStart, '\n', textEnd - lineStart));
+        if (newline == NULL)
+            newline = textEnd;
+        if (ParseTraceLine(lineStart, newline, fields.mode, fields.dataSize, fields.address, fields.core) >= 3 &&
+            ValidateTraceFields(lineNumber, fields))
+        {
+            Ref ref = {fields.address, fields.dataSize, fields.mode};
+            trace.push_back(ref);
+        }
+        lineStart = (newline == textEnd) ? textEnd : newline + 1;
+    }
+    if (trace.empty())
+    {
+        std::cerr << "Data file has no valid references.\n";
+        return EXIT_FAILURE;
+    }
+
+    size_t targetRefs = (argc > 5) ? strtoull(argv[5], NULL, 10) : trace.size();
+    size_t batchSize = (argc > 6) ? strtoull(argv[6], NULL, 10) : 4096;
+    if (batchSize == 0)
+        batchSize = 1;
+
+    RunTotals single  = TimeRun("one per call", config, trace, targetRefs, 1);
+    RunTotals batched = TimeRun("batched     ", config, trace, targetRefs, batchSize);
+
+    if (single.checksum != batched.checksum || single.hits != batched.hits || single.misses != batched.misses)
+    {
+        std::cerr << "Runs disagree: checksum " << single.checksum << " vs " << batched.checksum << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
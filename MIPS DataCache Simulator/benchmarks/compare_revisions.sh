@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# MIPS DataCache Simulator - before/after benchmark
+#
+# Builds datacache.cpp from two git revisions (or the working tree) and times both on the same trace and
+# configuration.  The per-reference output of the two builds is compared so a speedup never hides a
+# behaviour change.
+#
+# Usage:
+#   ./compare_revisions.sh <old-rev> <new-rev|worktree> <trace> [sets ways linesize] [repeat]
+#
+#   repeat  concatenates the trace with itself this many times first (default 1), e.g.
+#           ./compare_revisions.sh HEAD~1 worktree ../testBig4.dat 8192 8 64 2000
+#
+#   SIM_OPTIONS in the environment is passed to both builds, e.g. SIM_OPTIONS=--summary-only to time the cache
+#   model without the per-reference output
+#
+
+set -e
+
+if [ $# -lt 3 ]; then
+    sed -n '3,17p' "$0"
+    exit 1
+fi
+
+OLD_REV=$1
+NEW_REV=$2
+TRACE=$3
+SETS=${4:-8192}
+WAYS=${5:-8}
+LINE=${6:-64}
+REPEAT=${7:-1}
+
+SRC_DIR=$(cd "$(dirname "$0")/.." && pwd)
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# build <rev> <output>; sources are exported so headers from that revision are used
+build() {
+    mkdir -p "$WORK_DIR/src-$2"
+    if [ "$1" = "worktree" ]; then
+        cp "$SRC_DIR"/*.cpp "$SRC_DIR"/*.h "$WORK_DIR/src-$2" 2>/dev/null || true
+    else
+        (cd "$SRC_DIR" && git archive "$1" .) | tar -x -C "$WORK_DIR/src-$2"
+    fi
+    g++ -O2 -pthread -I"$WORK_DIR/src-$2" -o "$WORK_DIR/$2" "$WORK_DIR/src-$2/datacache.cpp"
+}
+
+build "$OLD_REV" old
+build "$NEW_REV" new
+
+i=0
+: > "$WORK_DIR/trace.dat"
+while [ $i -lt "$REPEAT" ]; do
+    cat "$TRACE" >> "$WORK_DIR/trace.dat"
+    i=$((i + 1))
+done
+printf "Number of sets: %s\nSet size: %s\nLine size: %s\n" "$SETS" "$WAYS" "$LINE" > "$WORK_DIR/trace.config"
+echo "$(wc -l < "$WORK_DIR/trace.dat") references, $SETS sets, $WAYS ways, $LINE byte lines"
+
+# run <binary>: best wall time of three runs
+run() {
+    best=""
+    for attempt in 1 2 3; do
+        start=$(date +%s.%N)
+        (cd "$WORK_DIR" && "./$1" $SIM_OPTIONS < trace.dat > "$1.out" 2> /dev/null)
+        end=$(date +%s.%N)
+        best=$(awk -v s="$start" -v e="$end" -v b="$best" 'BEGIN { t = e - s; if (b == "" || t < b) b = t; printf "%.3f", b }')
+    done
+    echo "$best"
+}
+
+OLD_TIME=$(run old)
+NEW_TIME=$(run new)
+echo "$OLD_REV: ${OLD_TIME}s"
+echo "$NEW_REV: ${NEW_TIME}s"
+awk -v o="$OLD_TIME" -v n="$NEW_TIME" 'BEGIN { printf "speedup: %.2fx\n", o / n }'
+
+if ! cmp -s "$WORK_DIR/old.out" "$WORK_DIR/new.out"; then
+    echo "outputs differ"
+    exit 1
+fi
@@ -0,0 +1,67 @@
+/*
+ MIPS DataCache Simulator - stage timer
+
+ Runs one command and records its wall time and peak resident set size, as reported by wait4(), so the benchmark
+ script can time each stage in its own process without depending on GNU time.  stdin, stdout and stderr are passed
+ through to the command.  The result file gets one line: seconds, then peak RSS in KiB.
+
+ -------------------------------------
+ Compilation statement:
+ g++ -O2 -omeasure.x measure.cpp
+
+ Usage:
+ ./measure.x result.txt command [arguments...]
+ -------------------------------------
+ */
+
+#include <iostream>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " result.txt command [arguments...]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child < 0)
+    {
+        std::cerr << "Failed to start " << argv[2] << "\n";
+        return EXIT_FAILURE;
+    }
+    if (child == 0)
+    {
+        execvp(argv[2], argv + 2);
+        std::cerr << "Failed to run " << argv[2] << "\n";
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child)
+    {
+        std::cerr << "Lost track of " << argv[2] << "\n";
+        return EXIT_FAILURE;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    FILE *resultFile = fopen(argv[1], "w");
+    if (resultFile == NULL)
+    {
+        std::cerr << "Failed to open result file " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+    fprintf(resultFile, "%.6f %ld\n", seconds, usage.ru_maxrss); //ru_maxrss is in KiB on Linux
+    fclose(resultFile);
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+/*
+ MIPS DataCache Simulator - trace parser micro-benchmark
+
+ Compares the original parsing path (copy each line into a std::string, then sscanf "%c:%d:%x") against
+ ParseTraceLine() from traceparser.h working directly on the raw buffer.  The sample trace is replayed
+ in memory until the requested number of lines has been parsed, so no disk I/O is measured.
+
+ -------------------------------------
+ Compilation statement:
+ g++ -O2 -I.. -oparsebench.x parsebench.cpp
+
+ Usage:
+ ./parsebench.x ../testBig4.dat [lines]      (lines defaults to 100000000)
+ -------------------------------------
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "traceparser.h"
+
+//Accumulates the parsed fields so the compiler cannot discard the work
+struct ParseResult
+{
+    size_t lines;
+    uint64_t checksum;
+};
+
+//Folds one record into the checksum; every field is widened as unsigned, so the sum wraps instead of overflowing
+void AddToChecksum(ParseResult & result, char mode, unsigned int dataSize, unsigned int address)
+{
+    result.checksum += static_cast<unsigned char>(mode) + dataSize * uint64_t(31) + address * uint64_t(131);
+}
+
+//Original path: one std::string per line plus sscanf
+ParseResult ParseWithSscanf(const std::string & trace, size_t targetLines)
+{
+    ParseResult result = {0, 0};
+    char mode = '\0';
+    int dataSize = 0; //%d, as the original parser read it
+    unsigned int address = 0;
+    std::string inputLine;
+
+    while (result.lines < targetLines)
+    {
+        std::istringstream traceStream(trace);
+        while (result.lines < targetLines && std::getline(traceStream, inputLine))
+        {
+            sscanf(inputLine.c_str(), "%c:%d:%x", &mode, &dataSize, &address);
+            AddToChecksum(result, mode, static_cast<unsigned int>(dataSize), address);
+            ++result.lines;
+        }
+    }
+    return result;
+}
+
+//New path: ParseTraceLine on the raw bytes
+ParseResult ParseInPlace(const std::string & trace, size_t targetLines)
+{
+    ParseResult result = {0, 0};
+    char mode = '\0';
+    unsigned int dataSize = 0;
+    unsigned int address = 0;
+    unsigned int core = 0;
+    const char *traceEnd = trace.data() + trace.size();
+
+    while (result.lines < targetLines)
+    {
+        const char *lineStart = trace.data();
+        const char *newline;
+        while (result.lines < targetLines && lineStart != traceEnd)
+        {
+            newline = static_cast<const char *>(memchr(lineStart, '\n', traceEnd - lineStart));
+            if (newline == NULL)
+                newline = traceEnd;
+            ParseTraceLine(lineStart, newline, mode, dataSize, address, core);
+            AddToChecksum(result, mode, dataSize, address);
+            ++result.lines;
+            lineStart = (newline == traceEnd) ? traceEnd : newline + 1;
+        }
+    }
+    return result;
+}
+
+//Runs one parser and prints its throughput
+ParseResult TimeParser(const char *name, ParseResult (*parser)(const std::string &, size_t),
+                       const std::string & trace, size_t targetLines)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ParseResult result = parser(trace, targetLines);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << name << ": " << result.lines << " lines in " << elapsed.count() << " s ("
+              << (result.lines / elapsed.count() / 1e6) << " M lines/s)\n";
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " trace.dat [lines]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream inDatFile(argv[1], std::ios::in | std::ios::binary);
+    if (!inDatFile)
+    {
+        std::cerr << "Failed to read data file.\n";
+        return EXIT_FAILURE;
+    }
+    std::ostringstream contents;
+    contents << inDatFile.rdbuf();
+    std::string trace = contents.str();
+    if (trace.empty())
+    {
+        std::cerr << "Data file is empty.\n";
+        return EXIT_FAILURE;
+    }
+    if (trace[trace.size() - 1] != '\n')
+        trace += '\n'; //so that replaying the trace does not join its last and first lines
+
+    size_t targetLines = (argc > 2) ? strtoull(argv[2], NULL, 10) : 100000000;
+
+    ParseResult scanned = TimeParser("sscanf        ", ParseWithSscanf, trace, targetLines);
+    ParseResult parsed  = TimeParser("ParseTraceLine", ParseInPlace, trace, targetLines);
+
+    if (scanned.checksum != parsed.checksum)
+    {
+        std::cerr << "Parsers disagree: checksum " << scanned.checksum << " vs " << parsed.checksum << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/*
+ MIPS DataCache Simulator - set probe micro-benchmark
+
+ Times every tag match kernel of tagmatch.h that the running CPU supports on the same probes.  A table of sets laid
+ out like CacheStorage (eight tags per set) is filled with random tags, and each probe looks for either a tag of its
+ set or one that is not there, half and half.  Every set is fully valid.  The number of ways is a compile time
+ constant, as in the simulator's per-associativity access kernels, so the kernels that can inline do.  All kernels
+ must return the same matches.
+
+ -------------------------------------
+ Compilation statement:
+ g++ -O2 -I.. -oprobebench.x probebench.cpp
+
+ Usage:
+ ./probebench.x [probes]      (probes defaults to 100000000 per kernel and associativity)
+ -------------------------------------
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tagmatch.h"
+
+const size_t PROBE_SETS = 4096;
+const size_t TAGS_PER_SET = 8; //as CacheStorage keeps them
+const size_t PROBE_COUNT = 65536; //distinct probes, replayed until the requested number has run
+const char * const KERNEL_NAMES[] = {"scalar", "sse2", "sse4.1", "avx2"}; //as --probe takes them
+const size_t KERNEL_COUNT = sizeof(KERNEL_NAMES) / sizeof(KERNEL_NAMES[0]);
+
+struct Probe
+{
+    uint32_t set;
+    uint64_t tag;
+};
+
+//Small xorshift generator, so every run probes the same tables
+uint64_t NextRandom(uint64_t & state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+//Runs the probes through kernel and returns a checksum of the matches
+template <size_t WAYS>
+uint64_t RunProbes(TagMatchKernel kernel, const std::vector<uint64_t> & tags, const std::vector<Probe> & probes, size_t count)
+{
+    const unsigned char validMask = static_cast<unsigned char>((1u << WAYS) - 1);
+    uint64_t checksum = 0;
+    for (size_t done = 0; done < count; )
+    {
+        for (size_t i = 0; i < probes.size() && done < count; ++i, ++done)
+            checksum = checksum * 31 + RunTagMatch(kernel, &tags[probes[i].set * TAGS_PER_SET], validMask, probes[i].tag, WAYS);
+    }
+    return checksum;
+}
+
+//Times every kernel at one associativity.  Returns FALSE if a kernel disagrees with the scalar one.
+template <size_t WAYS>
+bool TimeKernels(const std::vector<uint64_t> & tags, size_t count)
+{
+    std::vector<Probe> probes(PROBE_COUNT);
+    uint64_t random = 88172645463325252ULL + WAYS;
+    for (size_t i = 0; i < probes.size(); ++i)
+    {
+        probes[i].set = static_cast<uint32_t>(NextRandom(random) % PROBE_SETS);
+        if (NextRandom(random) & 1)
+            probes[i].tag = tags[probes[i].set * TAGS_PER_SET + NextRandom(random) % WAYS]; //a hit
+        else
+            probes[i].tag = NextRandom(random) | 1; //every stored tag is even, so a miss
+    }
+
+    uint64_t expected = RunProbes<WAYS>(TagMatchScalar, tags, probes, count);
+    for (size_t k = 0; k < KERNEL_COUNT; ++k)
+    {
+        TagMatchKernel kernel = SelectTagMatchKernel(KERNEL_NAMES[k]);
+        if (kernel == NULL)
+            continue; //not supported here
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t checksum = RunProbes<WAYS>(kernel, tags, probes, count);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << WAYS << "-way " << KERNEL_NAMES[k] << ": " << (count / elapsed.count() / 1e6) << " M probes/s\n";
+        if (checksum != expected)
+        {
+            std::cerr << "Kernel " << KERNEL_NAMES[k] << " disagrees with the scalar kernel at " << WAYS << " ways\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t count = (argc > 1) ? strtoull(argv[1], NULL, 10) : 100000000;
+
+    std::vector<uint64_t> tags(PROBE_SETS * TAGS_PER_SET);
+    uint64_t random = 2463534242ULL;
+    for (size_t i = 0; i < tags.size(); ++i)
+        tags[i] = NextRandom(random) & ~uint64_t(1);
+
+    for (size_t k = 0; k < KERNEL_COUNT; ++k)
+    {
+        if (SelectTagMatchKernel(NULL) == SelectTagMatchKernel(KERNEL_NAMES[k]))
+            std::cout << "auto picks " << KERNEL_NAMES[k] << "\n";
+    }
+    if (!TimeKernels<1>(tags, count) || !TimeKernels<2>(tags, count) || !TimeKernels<4>(tags, count) ||
+        !TimeKernels<8>(tags, count))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
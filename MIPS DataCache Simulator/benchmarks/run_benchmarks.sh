@@ -0,0 +1,136 @@
+#!/bin/sh
+#
+# MIPS DataCache Simulator - benchmark suite
+#
+# Builds the simulator, traceconvert and tracegen from the working tree, then:
+#
+#  1) checks the output of every sample trace (../*.dat) under each golden configuration against the stored
+#     output in golden/, so a speedup never hides a behaviour change
+#  2) runs the same traces and configurations with every set probe kernel the CPU supports (--probe sse2, sse4.1,
+#     avx2, each with --verify-probe) and checks that the output matches --probe scalar
+#  3) generates every synthetic pattern with tracegen and times three stages on it, each in its own process, with
+#     references per second and peak RSS:
+#        parse     traceconvert reads the text trace and checks and packs every reference
+#        simulate  the simulator runs the binary trace with --summary-only, so mostly the cache model is timed
+#        output    the simulator runs the binary trace and formats every result row (written to /dev/null)
+#
+# Usage:
+#   ./run_benchmarks.sh [references] [sets ways linesize]
+#
+#   references  per pattern (default 1000000).  Up to 1e9 works; the text trace takes about 12 bytes a reference.
+#
+#   UPDATE_GOLDEN=1 rewrites the golden outputs from the current build instead of checking them
+#   PATTERNS picks the patterns (default: sequential strided random pointer-chase zipf)
+#   TRACEGEN_OPTIONS is passed to tracegen, e.g. TRACEGEN_OPTIONS="--footprint 64M"
+#   SIM_OPTIONS is passed to the simulator in the simulate and output stages
+#
+
+set -e
+
+case "$1" in
+    -h|--help)
+        sed -n '3,25p' "$0"
+        exit 1
+        ;;
+esac
+
+REFERENCES=${1:-1000000}
+SETS=${2:-8192}
+WAYS=${3:-8}
+LINE=${4:-64}
+PATTERNS=${PATTERNS:-"sequential strided random pointer-chase zipf"}
+GOLDEN_CONFIGS="8x2x16 1x4x8 4x8x4 64x1x16"
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+SRC_DIR=$(cd "$BENCH_DIR/.." && pwd)
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+g++ -O2 -pthread -I"$SRC_DIR" -o "$WORK_DIR/datacache.x" "$SRC_DIR/datacache.cpp"
+g++ -O2 -I"$SRC_DIR" -o "$WORK_DIR/traceconvert.x" "$SRC_DIR/traceconvert.cpp"
+g++ -O2 -I"$SRC_DIR" -o "$WORK_DIR/tracegen.x" "$SRC_DIR/tracegen.cpp"
+g++ -O2 -o "$WORK_DIR/measure.x" "$BENCH_DIR/measure.cpp"
+
+# write_config <SETSxWAYSxLINE or "sets ways line">
+write_config() {
+    set -- $(echo "$*" | tr 'x' ' ')
+    printf "Number of sets: %s\nSet size: %s\nLine size: %s\n" "$1" "$2" "$3" > "$WORK_DIR/trace.config"
+}
+
+echo "Golden checks"
+mkdir -p "$BENCH_DIR/golden"
+FAILED=0
+for config in $GOLDEN_CONFIGS; do
+    write_config "$config"
+    for trace in "$SRC_DIR"/*.dat; do
+        name="$config-$(basename "$trace" .dat).out"
+        (cd "$WORK_DIR" && ./datacache.x < "$trace" > "$name" 2> /dev/null)
+        if [ -n "$UPDATE_GOLDEN" ]; then
+            cp "$WORK_DIR/$name" "$BENCH_DIR/golden/$name"
+        elif ! cmp -s "$WORK_DIR/$name" "$BENCH_DIR/golden/$name"; then
+            echo "   FAILED  $name"
+            FAILED=1
+        fi
+    done
+done
+if [ -n "$UPDATE_GOLDEN" ]; then
+    echo "   golden outputs rewritten"
+elif [ $FAILED -eq 0 ]; then
+    echo "   all $(ls "$BENCH_DIR/golden" | wc -l | tr -d ' ') outputs match"
+fi
+echo
+
+echo "Probe checks"
+KERNELS=""
+for kernel in sse2 sse4.1 avx2; do
+    # an unknown or unsupported kernel makes the simulator print its usage and fail
+    if (cd "$WORK_DIR" && ./datacache.x --probe $kernel --summary-only < /dev/null > /dev/null 2>&1); then
+        KERNELS="$KERNELS $kernel"
+    fi
+done
+PROBE_RUNS=0
+for config in $GOLDEN_CONFIGS; do
+    write_config "$config"
+    for trace in "$SRC_DIR"/*.dat; do
+        name="$config-$(basename "$trace" .dat)"
+        (cd "$WORK_DIR" && ./datacache.x --probe scalar < "$trace" > "$name-scalar.out" 2>&1) || true
+        for kernel in $KERNELS; do
+            (cd "$WORK_DIR" && ./datacache.x --probe $kernel --verify-probe < "$trace" > "$name-$kernel.out" 2>&1) || true
+            PROBE_RUNS=$((PROBE_RUNS + 1))
+            if ! cmp -s "$WORK_DIR/$name-scalar.out" "$WORK_DIR/$name-$kernel.out"; then
+                echo "   FAILED  $name with --probe $kernel"
+                FAILED=1
+            fi
+        done
+        rm -f "$WORK_DIR/$name"-*.out
+    done
+done
+echo "   $PROBE_RUNS runs with$KERNELS checked against --probe scalar"
+echo
+
+# stage <pattern> <name> <stdin> <command...>: runs one stage and prints its row
+stage() {
+    pattern=$1
+    name=$2
+    input=$3
+    shift 3
+    (cd "$WORK_DIR" && ./measure.x stage.txt "$@" < "$input" > /dev/null 2> /dev/null)
+    read seconds rss < "$WORK_DIR/stage.txt"
+    awk -v p="$pattern" -v n="$name" -v s="$seconds" -v r="$rss" -v refs="$REFERENCES" \
+        'BEGIN { printf "%-14s %-9s %10.3f %14.0f %10d KiB\n", p, n, s, (s > 0) ? refs / s : 0, r }'
+}
+
+write_config "$SETS $WAYS $LINE"
+echo "Throughput: $REFERENCES references per pattern, $SETS sets, $WAYS ways, $LINE byte lines"
+echo "pattern        stage        seconds         refs/s   peak RSS"
+echo "-------------- --------- ---------- -------------- ----------"
+for pattern in $PATTERNS; do
+    "$WORK_DIR/tracegen.x" "$pattern" "$REFERENCES" $TRACEGEN_OPTIONS > "$WORK_DIR/trace.dat"
+    stage "$pattern" parse "$WORK_DIR/trace.dat" ./traceconvert.x trace.bin
+    rm -f "$WORK_DIR/trace.dat"
+    stage "$pattern" simulate /dev/null ./datacache.x --trace trace.bin --summary-only $SIM_OPTIONS
+    stage "$pattern" output /dev/null ./datacache.x --trace trace.bin $SIM_OPTIONS
+    rm -f "$WORK_DIR/trace.bin"
+done
+
+exit $FAILED
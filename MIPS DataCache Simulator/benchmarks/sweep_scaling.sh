@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# MIPS DataCache Simulator - sweep thread scaling
+#
+# Builds the simulator, measure and tracegen from the working tree, generates one binary trace with tracegen and
+# runs the same --sweep over it with each listed --threads count.  Prints the wall time, peak RSS, speedup over one
+# thread and parallel efficiency of every run, and checks that every run prints the same sweep summary, since the
+# results must not depend on the number of threads.
+#
+# Usage:
+#   ./sweep_scaling.sh [references] [threads...]
+#
+#   references  in the trace (default 10000000)
+#   threads     thread counts to time (default 1 2 4 ... up to the number of online CPUs)
+#
+#   SWEEP picks the configurations (default 64-8192x1-8x16-128, 224 caches)
+#   PATTERN picks the tracegen pattern (default zipf); TRACEGEN_OPTIONS is passed to tracegen
+#
+
+set -e
+
+case "$1" in
+    -h|--help)
+        sed -n '3,18p' "$0"
+        exit 1
+        ;;
+esac
+
+REFERENCES=${1:-10000000}
+[ $# -gt 0 ] && shift
+SWEEP=${SWEEP:-"64-8192x1-8x16-128"}
+PATTERN=${PATTERN:-zipf}
+
+CPUS=$(getconf _NPROCESSORS_ONLN 2> /dev/null || echo 1)
+if [ $# -gt 0 ]; then
+    THREADS="$*"
+else
+    THREADS=1
+    n=2
+    while [ $n -le "$CPUS" ]; do
+        THREADS="$THREADS $n"
+        n=$((n * 2))
+    done
+    case " $THREADS " in
+        *" $CPUS "*) ;;
+        *) THREADS="$THREADS $CPUS" ;;
+    esac
+fi
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+SRC_DIR=$(cd "$BENCH_DIR/.." && pwd)
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+g++ -O2 -pthread -I"$SRC_DIR" -o "$WORK_DIR/datacache.x" "$SRC_DIR/datacache.cpp"
+g++ -O2 -I"$SRC_DIR" -o "$WORK_DIR/tracegen.x" "$SRC_DIR/tracegen.cpp"
+g++ -O2 -o "$WORK_DIR/measure.x" "$BENCH_DIR/measure.cpp"
+
+"$WORK_DIR/tracegen.x" "$PATTERN" "$REFERENCES" $TRACEGEN_OPTIONS --binary "$WORK_DIR/trace.bin"
+printf "Number of sets: 64\nSet size: 1\nLine size: 16\n" > "$WORK_DIR/trace.config" #--sweep replaces the geometry
+
+echo "Sweep scaling: $REFERENCES $PATTERN references, sweep $SWEEP, $CPUS online CPUs"
+echo "threads    seconds   speedup  efficiency   peak RSS"
+echo "------- ---------- --------- ----------- ----------"
+BASE=""
+FAILED=0
+for threads in $THREADS; do
+    (cd "$WORK_DIR" && ./measure.x stage.txt ./datacache.x --trace trace.bin --sweep "$SWEEP" --threads "$threads" \
+        > "summary-$threads.txt" 2> /dev/null)
+    read seconds rss < "$WORK_DIR/stage.txt"
+    [ -z "$BASE" ] && BASE=$seconds && BASE_THREADS=$threads
+    awk -v t="$threads" -v s="$seconds" -v b="$BASE" -v bt="$BASE_THREADS" -v r="$rss" \
+        'BEGIN { speedup = (s > 0) ? b / s : 0;
+                 printf "%7d %10.3f %8.2fx %10.0f%% %6d KiB\n", t, s, speedup, 100 * speedup * bt / t, r }'
+    if ! cmp -s "$WORK_DIR/summary-$BASE_THREADS.txt" "$WORK_DIR/summary-$threads.txt"; then
+        echo "   FAILED  the summary with $threads threads differs from the one with $BASE_THREADS"
+        FAILED=1
+    fi
+done
+if [ "$CPUS" -lt 2 ]; then
+    echo "Only one CPU is online, so the runs share it and no speedup can show."
+fi
+
+exit $FAILED
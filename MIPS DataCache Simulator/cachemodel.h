@@ -0,0 +1,592 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ The cache model: one cache's geometry, storage and counters, and the code that runs a reference or a line
+ operation against it.
+
+ AccessCache() simulates one reference that lies within one line, and is compiled once per replacement policy and
+ number of ways; SelectAccessKernel() returns the copy for a cache.  AccessLine() performs the line operations a
+ hierarchy, a prefetcher or a coherence protocol needs.  Nothing here reads the simulator's configuration: how a
+ cache handles stores and which kernel probes its sets are CacheOptions, fixed when InitCacheModel() sets it up,
+ so several differently configured caches can live in one program.  cachesim.h builds the library interface on
+ top of this; datacache.cpp drives it from a trace.
+
+ Addresses are 64 bits wide and every tag is stored in full, so no two lines alias.
+ */
+
+#ifndef CACHEMODEL_H
+#define CACHEMODEL_H
+
+#include <iostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "tagmatch.h"
+#include "cachestorage.h"
+#include "replacement.h"
+
+typedef uint64_t CacheAddress;
+
+//How one cache handles stores, and the kernel that probes its sets
+struct CacheOptions
+{
+    bool writeThrough; //stores also go to the level below and never dirty a line
+    bool writeAllocate; //a store miss brings the line into the cache
+    TagMatchKernel tagMatch; //set probe kernel; NULL picks the fastest one the CPU supports
+    bool verifyTagMatch; //cross-check every probe against the scalar kernel
+};
+
+//Sets, ways and line size of one cache
+struct CacheGeometry
+{
+    size_t numSets;
+    size_t associativityLevel;
+    size_t lineSize;
+};
+
+//What one reference did to one cache
+struct AccessResult
+{
+    CacheTag tag;
+    unsigned int index;
+    unsigned int offset;
+    unsigned int memrefs;
+    bool isThere; //hit
+    bool evicted; //a miss replaced a valid line
+    bool evictedDirty; //the replaced line was dirty
+    CacheAddress evictedAddress; //first address of the replaced line
+    bool fetched; //a miss brought the line in from the level below
+    bool storeThrough; //a store was written through or around the cache to the level below
+    unsigned int fetchedSectors; //sectors of the line that were fetched, written back or stored through; these are
+    unsigned int evictedSectors; //only meaningful for a sectored cache, where a transfer moves just these sectors
+    unsigned int storeSectors;
+};
+
+//Line level operations used between the levels of a hierarchy
+enum LineOperation
+{
+    LINE_READ, //look the line up; on a miss allocate it clean
+    LINE_INSERT, //a line arrives from the level above; allocate it if absent, dirty if the argument says so
+    LINE_INVALIDATE, //drop the line if present
+    LINE_SET_DIRTY, //mark the line dirty if present
+    LINE_PREFETCH, //a prefetched line arrives; allocate it clean and marked prefetched if absent
+    LINE_CLAIM, //a demand reference used the line; report and clear its prefetched mark
+    LINE_PROBE //only report whether the line is present
+};
+
+//What a line operation found and what it replaced
+struct LineResult
+{
+    bool hit; //the line was present
+    bool dirty; //it was dirty (before an invalidate)
+    bool evicted;
+    bool evictedDirty;
+    CacheAddress evictedAddress;
+    bool prefetched; //the line was marked prefetched (LINE_CLAIM)
+};
+
+//Simulates one reference against one cache; one copy of AccessCache() per policy and number of ways
+struct CacheModel;
+typedef void (*AccessKernel)(CacheModel &, const char, const CacheAddress, const unsigned int, AccessResult &);
+typedef void (*LineKernel)(CacheModel &, LineOperation, const CacheAddress, bool, LineResult &);
+
+//One simulated cache: its geometry, the address split derived from it, its storage and its counters.
+//Aligned so that caches updated by different sweep workers never share a cache line.
+struct alignas(64) CacheModel
+{
+    CacheGeometry geometry;
+    unsigned int offsetBitMask;
+    unsigned int offsetShamt;
+    unsigned int indexBitMask;
+    unsigned int indexShamt;
+    CacheStorage cacheAssociation;
+    size_t hitCounter;
+    size_t missCounter;
+    size_t refCounter; //holds the number of references read
+    AccessKernel accessKernel; //AccessCache() compiled for this cache's ways, chosen when the trace starts
+    size_t writebackCounter; //dirty lines sent to the level below
+    size_t invalidationCounter; //lines removed because an inclusive level below dropped them
+    LineKernel lineKernel; //AccessLine() for this cache's policy, set when it is part of a hierarchy
+    bool sectored; //lines are split into sectors with their own valid and dirty bits
+    unsigned int sectorShamt; //log2 of the sector size
+    CacheOptions options; //store handling and probe kernel, set by InitCacheModel()
+};
+
+
+//Function prototypes
+template <class Policy, size_t WAYS> void AccessCache(CacheModel &, const char, const CacheAddress, const unsigned int, AccessResult &);
+template <class Policy, class View> bool AccessSectors(CacheModel &, View &, const char, unsigned int, CacheTag, unsigned int, unsigned int,
+                                                       unsigned int &, AccessResult &);
+inline unsigned int SectorMask(const CacheModel &, const unsigned int, const unsigned int);
+inline size_t TransferBytes(const CacheModel &, const unsigned int);
+inline unsigned int BytesInFirstLine(const CacheModel &, const CacheAddress, const unsigned int);
+template <class Policy> AccessKernel SelectAccessKernel(size_t);
+template <class View> void NoteEviction(const CacheModel &, View &, unsigned int, size_t, AccessResult &);
+template <class Policy> void AccessLine(CacheModel &, LineOperation, const CacheAddress, bool, LineResult &);
+inline LineKernel SelectLineKernel(ReplacementPolicy);
+inline CacheAddress LineAddress(const CacheModel &, CacheTag, unsigned int);
+inline void InitCacheModel(CacheModel &, const CacheGeometry &, const CacheOptions &);
+inline void SectorCacheModel(CacheModel &, size_t);
+
+
+//Returns how many of the dataSize bytes at address lie in the cache line that holds address
+inline unsigned int BytesInFirstLine(const CacheModel & cache, const CacheAddress address, const unsigned int dataSize)
+{
+    unsigned int lineRemaining = cache.offsetBitMask - static_cast<unsigned int>(address & cache.offsetBitMask) + 1;
+    return (dataSize < lineRemaining) ? dataSize : lineRemaining;
+}
+
+
+
+//Records in result the line a miss is about to replace in way, so a hierarchy can pass it to the level below
+template <class View>
+void NoteEviction(const CacheModel & cache, View & cacheAssociation, unsigned int index, size_t way, AccessResult & result)
+{
+    if ((cacheAssociation.ValidMask(index) >> way) & 1)
+    {
+        result.evicted = true;
+        result.evictedDirty = cacheAssociation.IsDirty(index, way);
+        result.evictedAddress = LineAddress(cache, cacheAssociation.SetTags(index)[way], index);
+    }
+}
+
+
+
+//Returns the first address of the line with the given tag and index
+inline CacheAddress LineAddress(const CacheModel & cache, CacheTag tag, unsigned int index)
+{
+    return ((tag << cache.indexShamt) | index) << cache.offsetShamt;
+}
+
+
+
+//Returns AccessCache() for the given number of ways.  Every supported associativity has its own copy, in which the
+//ways are a constant; 0, or any other value, gets the generic copy that reads them from the cache.
+template <class Policy>
+AccessKernel SelectAccessKernel(size_t ways)
+{
+    switch (ways)
+    {
+        case 1:     return AccessCache<Policy, 1>;
+        case 2:     return AccessCache<Policy, 2>;
+        case 3:     return AccessCache<Policy, 3>;
+        case 4:     return AccessCache<Policy, 4>;
+        case 5:     return AccessCache<Policy, 5>;
+        case 6:     return AccessCache<Policy, 6>;
+        case 7:     return AccessCache<Policy, 7>;
+        case 8:     return AccessCache<Policy, 8>;
+        default:    return AccessCache<Policy, 0>;
+    }
+}
+
+
+
+//Simulates one reference against one cache and updates its counters.
+//WAYS is the cache's associativity, fixed at compile time so the probe and the replacement loops unroll, or 0 to
+//read it from the cache at run time.
+template <class Policy, size_t WAYS>
+void AccessCache(CacheModel & cache, const char mode, const CacheAddress address, const unsigned int dataSize, AccessResult & result)
+{
+    CacheStorageView<WAYS> cacheAssociation(cache.cacheAssociation);
+    unsigned int    index;
+    unsigned int    offset;
+    CacheTag        tag;
+    
+    //no size or alignment errors, increment ref Counter
+    ++cache.refCounter;
+
+    //Determine the index, offset, and tag
+    //The masks and shift amounts were worked out once from the geometry in InitCacheModel()
+    CacheAddress tempAddress = address; //to preserve oriignal address value
+    
+    offset = static_cast<unsigned int>(tempAddress & cache.offsetBitMask);       //determine offset
+    tempAddress = tempAddress >> cache.offsetShamt;
+    
+    index = static_cast<unsigned int>(tempAddress & cache.indexBitMask);         //determine index
+    tempAddress = tempAddress >> cache.indexShamt;
+    
+    tag = tempAddress; //determine tag from remaining bits
+    
+    //Write the result to the cache
+    //We don't need to worry about numSets; this is taken care of by Index.
+    //Line size is irrelevant for this portion
+    //We only have to worry about associativity level
+    
+    bool isThere = 0;
+    unsigned int memrefs = 0;
+    size_t hitSet = 0;
+    const size_t associativityLevel = cacheAssociation.Ways();
+    
+    //Relevant varibles: mode
+    //                   refCounter
+    //                   hitCounter
+    //                   missCounterisVal
+    //                   memrefs
+    //                   associativityLevel
+    //                   cacheAssociation[index is 0 to (associativityLevel -1)]
+    
+    memrefs = 0; //set memrefs to 0 to start with
+    result.evicted = false;
+    result.evictedDirty = false;
+    result.fetched = false;
+    result.storeThrough = false;
+    result.fetchedSectors = 1; //an unsectored line is a single sector
+    result.evictedSectors = 1;
+    result.storeSectors = 1;
+    
+    
+    //check to see if tag is already in corresponding index. "isThere" tells us if it is a hit or miss
+    //The tags of the set are contiguous, so the kernel compares every way at once.
+    const CacheTag *setTags = cacheAssociation.SetTags(index);
+    const unsigned char validMask = cacheAssociation.ValidMask(index);
+    unsigned int matchMask = RunTagMatch(cache.options.tagMatch, setTags, validMask, tag, associativityLevel);
+    if (cache.options.verifyTagMatch && matchMask != TagMatchScalar(setTags, validMask, tag, associativityLevel))
+    {
+        std::cerr << "Tag match kernel disagrees with the scalar probe at reference " << cache.refCounter << "\n";
+        exit(EXIT_FAILURE);
+    }
+    if (matchMask != 0)
+    {
+        isThere = 1;
+        hitSet = 31 - __builtin_clz(matchMask); //the highest matching way, as the original loop kept the last match
+    }
+    
+    //SECTORED**********
+    //The line is split into sectors that are filled and written back on their own.
+    if (cache.sectored)
+        isThere = AccessSectors<Policy>(cache, cacheAssociation, mode, index, tag, SectorMask(cache, offset, dataSize),
+                                        matchMask, memrefs, result);
+    
+    //HIT**********
+    //Now includes update of the replacement state.
+    else if (isThere) //if we found a hit, behavior will vary depending on whether it is a READ or a WRITE
+    {
+        if (mode == 'R' || mode == 'r') //if we are in read mode, memref will be 0.
+        {
+            Policy::OnHit(cacheAssociation, index, hitSet);
+        }
+        
+        else if (mode == 'W' || mode == 'w') // if we are in write mode, memref will be 0 unless writing through.
+        {
+            if (cache.options.writeThrough) //the store goes to the level below as well and the block stays clean
+            {
+                memrefs = 1;
+                result.storeThrough = true;
+            }
+            else
+                cacheAssociation.SetDirty(index, hitSet, true); //set dirty bit to 1, since we're writing to the block
+            cacheAssociation.SetValid(index, hitSet); //set valid bit to 1, regardless of previous state
+            cacheAssociation.SetTag(index, hitSet, tag); //set tag to computed value
+            
+            //Now, update the replacement state.
+            Policy::OnHit(cacheAssociation, index, hitSet);
+        } //else if - write mode
+        
+        else //program should never get here
+        {
+            std::cerr << "A fatal error occurred in HIT where the mode was neither Read nor Write.\n";
+            exit(EXIT_FAILURE);
+        }
+    } //HIT
+    
+    else //MISS********** - we did not find a match, now determine which to overwrite.  Memref value will vary.
+    {
+        memrefs = 1; //memrefs will be at least 1.
+        
+        if (mode == 'R' || mode == 'r') //if we are in read mode with a miss
+        {
+            size_t indexToUse = Policy::Victim(cacheAssociation, index); //first, determine which index to use.
+            NoteEviction(cache, cacheAssociation, index, indexToUse, result);
+            
+            if (cacheAssociation.IsDirty(index, indexToUse)) //if the block we're about to overwrite is dirty
+            {
+                memrefs = 2; //set memrefs =2
+                ++cache.writebackCounter;
+                cacheAssociation.SetDirty(index, indexToUse, false); //set dirtyBit back to 0, this is read mode
+            }
+            
+            //Now, update the remaining portions of the block.
+            cacheAssociation.SetValid(index, indexToUse); //in case it is already not 1
+            cacheAssociation.SetTag(index, indexToUse, tag);
+            
+            //Finally, update the replacement state for the replaced block.
+            Policy::OnFill(cacheAssociation, index, indexToUse);
+            result.fetched = true;
+        } //MISS - read mode
+        
+        else if (mode == 'W' || mode == 'w') //if we are in write mode with a miss
+        {
+            if (!cache.options.writeAllocate) //the store goes around the cache to the level below; nothing is replaced
+            {
+                result.storeThrough = true;
+            }
+            else
+            {
+                size_t indexToUse = Policy::Victim(cacheAssociation, index); //first, determine which index to use.
+                NoteEviction(cache, cacheAssociation, index, indexToUse, result);
+                
+                if (cacheAssociation.IsDirty(index, indexToUse)) //if the block we're about to overwrite is dirty
+                {
+                    memrefs = 2; //set memrefs =2
+                    ++cache.writebackCounter;
+                }
+                
+                if (cache.options.writeThrough) //fetch the block, then write the store through; the block stays clean
+                {
+                    ++memrefs;
+                    result.storeThrough = true;
+                    cacheAssociation.SetDirty(index, indexToUse, false);
+                }
+                else
+                    cacheAssociation.SetDirty(index, indexToUse, true); //maintain the dirty bit set, as we are writing to the block.
+                
+                //Now, update the remaining portions of the block.
+                cacheAssociation.SetValid(index, indexToUse); //in case it is already not 1
+                cacheAssociation.SetTag(index, indexToUse, tag);
+                
+                //Finally, update the replacement state for the replaced block.
+                Policy::OnFill(cacheAssociation, index, indexToUse);
+                result.fetched = true;
+            }
+        } //MISS - write mode
+        
+        else //program should never get here
+        {
+            std::cerr << "A fatal error occurred in MISS where the mode was neither R nor W.\n";
+            exit(EXIT_FAILURE);
+        }
+    } //MISS
+    
+    if (isThere) //if it was a hit
+        ++cache.hitCounter;
+    else
+        ++cache.missCounter;
+    
+    result.tag = tag;
+    result.index = index;
+    result.offset = offset;
+    result.memrefs = memrefs;
+    result.isThere = isThere;
+}
+
+
+
+//Returns the sectors of a line that hold the bytes [offset, offset + dataSize), bit n for sector n
+inline unsigned int SectorMask(const CacheModel & cache, const unsigned int offset, const unsigned int dataSize)
+{
+    unsigned int first = offset >> cache.sectorShamt;
+    unsigned int last = (offset + dataSize - 1) >> cache.sectorShamt;
+    return ((2u << last) - 1) & ~((1u << first) - 1); //2u << 31 wraps to 0, so the last sector works too
+}
+
+
+
+//Returns the bytes a transfer of the given sectors of a line moves; an unsectored cache always moves a whole line
+inline size_t TransferBytes(const CacheModel & cache, const unsigned int sectors)
+{
+    if (!cache.sectored)
+        return cache.geometry.lineSize;
+    return static_cast<size_t>(__builtin_popcount(sectors)) << cache.sectorShamt;
+}
+
+
+
+//Simulates one reference against a sectored cache and returns TRUE for a hit.  A hit needs the line and every
+//sector the reference touches.  When the line is present without some of them, the missing sectors are fetched
+//and nothing is replaced; a replaced line writes back only its dirty sectors.  Memrefs counts the transfers.
+template <class Policy, class View>
+bool AccessSectors(CacheModel & cache, View & cacheAssociation, const char mode, unsigned int index, CacheTag tag,
+                   unsigned int sectors, unsigned int matchMask, unsigned int & memrefs, AccessResult & result)
+{
+    bool isWrite = (mode == 'W' || mode == 'w');
+    size_t way = 0;
+    unsigned int missingSectors = sectors;
+    if (matchMask != 0)
+    {
+        way = 31 - __builtin_clz(matchMask); //the highest matching way, as in the unsectored probe
+        missingSectors &= ~cacheAssociation.ValidSectors(index, way);
+    }
+    
+    if (missingSectors != 0 && isWrite && !cache.options.writeAllocate) //the store goes around the cache; nothing is filled
+    {
+        memrefs = 1;
+        result.storeThrough = true;
+        result.storeSectors = sectors;
+        return false;
+    }
+    
+    if (matchMask == 0) //replace a line; it starts with no sectors
+    {
+        way = Policy::Victim(cacheAssociation, index);
+        NoteEviction(cache, cacheAssociation, index, way, result);
+        if (cacheAssociation.IsDirty(index, way))
+        {
+            ++memrefs;
+            ++cache.writebackCounter;
+            result.evictedSectors = cacheAssociation.DirtySectors(index, way);
+        }
+        cacheAssociation.SetDirty(index, way, false);
+        cacheAssociation.ValidSectors(index, way) = 0;
+        cacheAssociation.DirtySectors(index, way) = 0;
+        cacheAssociation.SetValid(index, way);
+        cacheAssociation.SetTag(index, way, tag);
+        Policy::OnFill(cacheAssociation, index, way);
+    }
+    else
+        Policy::OnHit(cacheAssociation, index, way);
+    
+    if (missingSectors != 0)
+    {
+        ++memrefs;
+        result.fetched = true;
+        result.fetchedSectors = missingSectors;
+        cacheAssociation.ValidSectors(index, way) |= missingSectors;
+    }
+    
+    if (isWrite)
+    {
+        if (cache.options.writeThrough)
+        {
+            ++memrefs;
+            result.storeThrough = true;
+            result.storeSectors = sectors;
+        }
+        else
+        {
+            cacheAssociation.DirtySectors(index, way) |= sectors;
+            cacheAssociation.SetDirty(index, way, true);
+        }
+    }
+    return missingSectors == 0;
+}
+
+
+
+//Performs one line operation on a cache of a hierarchy and reports what it found and replaced.
+//Lower levels only see the data cache's misses, so this uses the generic storage view rather than one per ways.
+template <class Policy>
+void AccessLine(CacheModel & cache, LineOperation operation, const CacheAddress address, bool dirty, LineResult & result)
+{
+    CacheStorageView<0> cacheAssociation(cache.cacheAssociation);
+    unsigned int index = static_cast<unsigned int>((address >> cache.offsetShamt) & cache.indexBitMask);
+    CacheTag tag = address >> cache.offsetShamt >> cache.indexShamt;
+    
+    unsigned int matchMask = RunTagMatch(cache.options.tagMatch, cacheAssociation.SetTags(index), cacheAssociation.ValidMask(index), tag,
+                                         cacheAssociation.Ways());
+    result.hit = (matchMask != 0);
+    result.dirty = false;
+    result.evicted = false;
+    result.evictedDirty = false;
+    result.prefetched = false;
+    
+    if (result.hit)
+    {
+        size_t way = 31 - __builtin_clz(matchMask);
+        result.dirty = cacheAssociation.IsDirty(index, way);
+        switch (operation)
+        {
+            case LINE_READ:
+                Policy::OnHit(cacheAssociation, index, way);
+                break;
+            case LINE_INSERT:
+                if (dirty)
+                    cacheAssociation.SetDirty(index, way, true);
+                Policy::OnHit(cacheAssociation, index, way);
+                break;
+            case LINE_INVALIDATE:
+                cacheAssociation.ClearValid(index, way);
+                cacheAssociation.SetDirty(index, way, false);
+                Policy::OnInvalidate(cacheAssociation, index, way);
+                break;
+            case LINE_SET_DIRTY:
+                cacheAssociation.SetDirty(index, way, true);
+                break;
+            case LINE_PREFETCH: //already here, the prefetch is dropped
+            case LINE_PROBE:
+                break;
+            case LINE_CLAIM:
+                result.prefetched = cacheAssociation.IsPrefetched(index, way);
+                cacheAssociation.SetPrefetched(index, way, false);
+                break;
+        }
+        return;
+    }
+    
+    if (operation != LINE_READ && operation != LINE_INSERT && operation != LINE_PREFETCH) //nothing to do for an absent line
+        return;
+    
+    //allocate the line, replacing the policy's victim
+    size_t way = Policy::Victim(cacheAssociation, index);
+    if ((cacheAssociation.ValidMask(index) >> way) & 1)
+    {
+        result.evicted = true;
+        result.evictedDirty = cacheAssociation.IsDirty(index, way);
+        result.evictedAddress = LineAddress(cache, cacheAssociation.SetTags(index)[way], index);
+    }
+    cacheAssociation.SetDirty(index, way, operation == LINE_INSERT && dirty);
+    cacheAssociation.SetPrefetched(index, way, operation == LINE_PREFETCH);
+    cacheAssociation.SetValid(index, way);
+    cacheAssociation.SetTag(index, way, tag);
+    Policy::OnFill(cacheAssociation, index, way);
+}
+
+
+
+//Returns AccessLine() for a replacement policy
+inline LineKernel SelectLineKernel(ReplacementPolicy policy)
+{
+    switch (policy)
+    {
+        case POLICY_LRU:        return AccessLine<LruPolicy>;
+        case POLICY_TREE_PLRU:  return AccessLine<TreePlruPolicy>;
+        case POLICY_NRU:        return AccessLine<NruPolicy>;
+        case POLICY_FIFO:       return AccessLine<FifoPolicy>;
+        case POLICY_RANDOM:     return AccessLine<RandomPolicy>;
+        case POLICY_SRRIP:      return AccessLine<SrripPolicy>;
+        case POLICY_BRRIP:      return AccessLine<BrripPolicy>;
+    }
+    return AccessLine<LruPolicy>;
+}
+
+
+
+//Sets up a cache with the given geometry and options: empty storage, zero counters and the address split.
+inline void InitCacheModel(CacheModel & cache, const CacheGeometry & geometry, const CacheOptions & options)
+{
+    cache.geometry = geometry;
+    cache.offsetBitMask = static_cast<unsigned int>(geometry.lineSize - 1);
+    cache.offsetShamt = static_cast<unsigned int>(log2(geometry.lineSize));
+    cache.indexBitMask = static_cast<unsigned int>(geometry.numSets - 1);
+    cache.indexShamt = static_cast<unsigned int>(log2(geometry.numSets));
+    cache.cacheAssociation.Resize(geometry.numSets, geometry.associativityLevel);
+    cache.hitCounter = 0;
+    cache.missCounter = 0;
+    cache.refCounter = 0;
+    cache.accessKernel = NULL;
+    cache.writebackCounter = 0;
+    cache.invalidationCounter = 0;
+    cache.lineKernel = NULL;
+    cache.sectored = false;
+    cache.sectorShamt = cache.offsetShamt;
+    cache.options = options;
+    if (cache.options.tagMatch == NULL)
+        cache.options.tagMatch = SelectTagMatchKernel(NULL);
+}
+
+
+
+//Splits every line of a freshly set up cache into sectors of sectorSize bytes; a single sector per line leaves it
+//an ordinary cache
+inline void SectorCacheModel(CacheModel & cache, size_t sectorSize)
+{
+    if (sectorSize == 0 || sectorSize >= cache.geometry.lineSize)
+        return;
+    cache.sectored = true;
+    cache.sectorShamt = static_cast<unsigned int>(log2(sectorSize));
+    cache.cacheAssociation.EnableSectors();
+}
+
+#endif
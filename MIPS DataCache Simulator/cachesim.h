@@ -0,0 +1,250 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Library interface to the cache model.
+
+ A Cache is one data cache with its own geometry, replacement policy and store handling and nothing global behind
+ it, so a program can hold as many as it likes and feed them from its own trace reader or an instrumentation pass.
+ References are passed in batches: Access() takes an array of Refs and writes one RefResult per reference into an
+ array the caller owns.  The policy and the copy of the access code compiled for the cache's ways are picked once,
+ when the Cache is built, and the call through that pointer is paid once per batch; inside the batch every
+ reference runs through AccessCache() inlined into the loop.
+
+    CacheConfig config = {64, 4, 16, POLICY_LRU, false, true, 0};
+    if (CheckCacheConfig(config) == NULL)
+    {
+        Cache cache(config);
+        size_t done = cache.Access(refs, count, results);
+        if (done < count)
+            std::cerr << "Reference " << done << ": " << CheckRef(refs[done]) << "\n";
+    }
+
+ A Ref with a mode other than R or W, or a size of 0, is not simulated: Access() stops in front of it and returns how
+ many references it did simulate, and CheckRef() says what is wrong with the one it stopped at, so a bad
+ reference never ends the host program.
+
+ Addresses are 64 bits wide and tags are kept in full.  A reference that runs past the end of a line is one access
+ per line it touches, as in the simulator: its result is a hit only if every line hit, memrefs adds up their
+ transfers, and the tag, index and offset are those of the first line.  The counters count line accesses.
+ */
+
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#include "cachemodel.h"
+
+const size_t CACHE_MAX_WAYS = 8; //the valid, dirty and match masks have one bit per way in a byte
+const size_t CACHE_MAX_SECTORS_PER_LINE = 32; //one bit per sector in the sector masks
+
+//Everything that describes one cache
+struct CacheConfig
+{
+    size_t sets; //a power of two
+    size_t ways; //1 to CACHE_MAX_WAYS
+    size_t lineSize; //bytes, a power of two
+    ReplacementPolicy policy;
+    bool writeThrough; //stores also go to the level below and never dirty a line
+    bool writeAllocate; //a store miss brings the line into the cache
+    size_t sectorSize; //bytes per sector, a power of two; 0 for lines that are not sectored
+};
+
+//One reference of a batch
+struct Ref
+{
+    uint64_t address;
+    uint32_t size; //bytes, at least 1
+    char mode; //'R' for a load or 'W' for a store, in either case
+};
+
+//What one reference did
+struct RefResult
+{
+    uint64_t tag; //of the first line the reference touched
+    uint32_t index;
+    uint32_t offset;
+    uint32_t memrefs; //transfers to and from the level below
+    bool hit;
+};
+
+
+//Returns NULL if ref can be simulated, or else what is wrong with it
+inline const char * CheckRef(const Ref & ref)
+{
+    if (ref.mode != 'R' && ref.mode != 'r' && ref.mode != 'W' && ref.mode != 'w')
+        return "the mode must be R or W";
+    if (ref.size == 0)
+        return "the size must be at least 1 byte";
+    return NULL;
+}
+
+//Runs a batch of references through a cache compiled for its policy and ways, up to the first one CheckRef() rejects.
+//Returns the number of references simulated.
+template <class Policy, size_t WAYS>
+size_t AccessBatch(CacheModel & cache, const Ref *refs, size_t count, RefResult *results)
+{
+    AccessResult lineResult;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (CheckRef(refs[i]) != NULL)
+            return i;
+
+        CacheAddress address = refs[i].address;
+        unsigned int remaining = refs[i].size;
+        unsigned int size = BytesInFirstLine(cache, address, remaining);
+        AccessCache<Policy, WAYS>(cache, refs[i].mode, address, size, lineResult);
+
+        RefResult & result = results[i];
+        result.tag = lineResult.tag;
+        result.index = lineResult.index;
+        result.offset = lineResult.offset;
+        result.memrefs = lineResult.memrefs;
+        result.hit = lineResult.isThere;
+
+        //the rest of a reference that runs past the end of its line
+        while (remaining > size)
+        {
+            remaining -= size;
+            address += size;
+            size = BytesInFirstLine(cache, address, remaining);
+            AccessCache<Policy, WAYS>(cache, refs[i].mode, address, size, lineResult);
+            result.memrefs += lineResult.memrefs;
+            result.hit = result.hit && lineResult.isThere;
+        }
+    }
+    return count;
+}
+
+typedef size_t (*BatchKernel)(CacheModel &, const Ref *, size_t, RefResult *);
+
+//Returns AccessBatch() for the given number of ways, as SelectAccessKernel() does for AccessCache()
+template <class Policy>
+BatchKernel SelectBatchKernel(size_t ways)
+{
+    switch (ways)
+    {
+        case 1:     return AccessBatch<Policy, 1>;
+        case 2:     return AccessBatch<Policy, 2>;
+        case 3:     return AccessBatch<Policy, 3>;
+        case 4:     return AccessBatch<Policy, 4>;
+        case 5:     return AccessBatch<Policy, 5>;
+        case 6:     return AccessBatch<Policy, 6>;
+        case 7:     return AccessBatch<Policy, 7>;
+        case 8:     return AccessBatch<Policy, 8>;
+        default:    return AccessBatch<Policy, 0>;
+    }
+}
+
+//Returns NULL if a Cache can be built from config, or else what is wrong with it
+inline const char * CheckCacheConfig(const CacheConfig & config)
+{
+    if (config.sets == 0 || (config.sets & (config.sets - 1)) != 0 || config.sets > 0x80000000u)
+        return "the number of sets must be a power of two up to 2^31";
+    if (config.ways == 0 || config.ways > CACHE_MAX_WAYS)
+        return "the set size must be 1 to 8 ways";
+    if (config.lineSize == 0 || (config.lineSize & (config.lineSize - 1)) != 0 || config.lineSize > 0x80000000u)
+        return "the line size must be a power of two up to 2^31";
+    if (config.sectorSize != 0 && ((config.sectorSize & (config.sectorSize - 1)) != 0 || config.sectorSize > config.lineSize ||
+                                   config.lineSize / config.sectorSize > CACHE_MAX_SECTORS_PER_LINE))
+        return "the sector size must be a power of two no larger than the line, with at most 32 sectors per line";
+    return NULL;
+}
+
+
+//One cache, simulated a batch of references at a time
+class Cache
+{
+public:
+    //builds an empty cache; config must pass CheckCacheConfig()
+    explicit Cache(const CacheConfig & config)
+        : config(config)
+    {
+        switch (config.policy)
+        {
+            case POLICY_LRU:        batchKernel = SelectBatchKernel<LruPolicy>(config.ways);      break;
+            case POLICY_TREE_PLRU:  batchKernel = SelectBatchKernel<TreePlruPolicy>(config.ways); break;
+            case POLICY_NRU:        batchKernel = SelectBatchKernel<NruPolicy>(config.ways);      break;
+            case POLICY_FIFO:       batchKernel = SelectBatchKernel<FifoPolicy>(config.ways);     break;
+            case POLICY_RANDOM:     batchKernel = SelectBatchKernel<RandomPolicy>(config.ways);   break;
+            case POLICY_SRRIP:      batchKernel = SelectBatchKernel<SrripPolicy>(config.ways);    break;
+            case POLICY_BRRIP:      batchKernel = SelectBatchKernel<BrripPolicy>(config.ways);    break;
+            default:                batchKernel = SelectBatchKernel<LruPolicy>(config.ways);      break;
+        }
+        Reset();
+    }
+
+    //simulates refs[0] to refs[count - 1] in order and writes the result of refs[i] to results[i].  Stops in front
+    //of the first ref CheckRef() rejects; returns the number of refs simulated, count if all of them were.
+    size_t Access(const Ref *refs, size_t count, RefResult *results)
+    {
+        return batchKernel(model, refs, count, results);
+    }
+
+#if __cplusplus >= 202002L
+    //as above; results must be at least as long as refs
+    size_t Access(std::span<const Ref> refs, std::span<RefResult> results)
+    {
+        return batchKernel(model, refs.data(), refs.size(), results.data());
+    }
+#endif
+
+    //empties the cache and zeroes its counters
+    void Reset()
+    {
+        CacheGeometry geometry = {config.sets, config.ways, config.lineSize};
+        CacheOptions options = {config.writeThrough, config.writeAllocate, NULL, false};
+        InitCacheModel(model, geometry, options);
+        SectorCacheModel(model, config.sectorSize);
+    }
+
+    size_t Hits() const
+    {
+        return model.hitCounter;
+    }
+
+    size_t Misses() const
+    {
+        return model.missCounter;
+    }
+
+    size_t Accesses() const
+    {
+        return model.refCounter;
+    }
+
+    //dirty lines written back to the level below
+    size_t Writebacks() const
+    {
+        return model.writebackCounter;
+    }
+
+    const CacheConfig & Config() const
+    {
+        return config;
+    }
+
+    //the model underneath, for the line operations and lower level calls of cachemodel.h
+    CacheModel & Model()
+    {
+        return model;
+    }
+
+    const CacheModel & Model() const
+    {
+        return model;
+    }
+
+private:
+    CacheConfig config;
+    CacheModel model;
+    BatchKernel batchKernel;
+
+}; //end class Cache
+
+#endif
@@ -0,0 +1,346 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Storage for the sets and ways of one cache.
+ */
+
+#ifndef CACHESTORAGE_H
+#define CACHESTORAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//A stored tag: every address bit above the index, so lines of a 64-bit address space never alias
+typedef uint64_t CacheTag;
+
+//Set-major storage for the cache.
+//The tags of one set sit next to each other, padded to a power of two ways, so probing a set of up to 8 ways reads
+//a single cache line.  Valid and dirty state are packed one bit per way into a byte per set, and the replacement state
+//(one byte per way plus one byte per set) is kept in its own arrays.  Only the configured sets x ways are allocated.
+//A sectored cache also keeps a valid and a dirty bit per sector of every line, allocated by EnableSectors().
+//A prefetched bit per way, packed like the dirty bits, marks lines a prefetcher brought in that are not yet used.
+class CacheStorage
+{
+public:
+    //default constructor
+    CacheStorage()
+    {
+        Resize(0, 0);
+    };
+    
+    //constructor with the geometry to allocate; every entry starts invalid, clean, with tag and LRU 0
+    CacheStorage(size_t sets, size_t ways)
+    {
+        Resize(sets, ways);
+    }
+    
+    void Resize(size_t sets, size_t ways)
+    {
+        numSets = sets;
+        numWays = ways;
+        tagStride = 1;
+        while (tagStride < ways)
+            tagStride <<= 1;
+        
+        size_t tagsPerLine = sizeof(TagLine) / sizeof(CacheTag);
+        tagLines.assign((sets * tagStride + tagsPerLine - 1) / tagsPerLine + 1, TagLine()); //one spare line so a full-width probe never reads past the end
+        validBits.assign(sets, 0);
+        dirtyBits.assign(sets, 0);
+        prefetchBits.assign(sets, 0);
+        lruCounters.assign(sets * ways, 0);
+        setStates.assign(sets, 0);
+        validSectors.clear();
+        dirtySectors.clear();
+        randomState = 0x9E3779B9; //fixed seed, so random replacement is repeatable
+    }
+    
+    //allocates the per-sector bits, one bit per sector of a line, all clear
+    void EnableSectors()
+    {
+        validSectors.assign(numSets * numWays, 0);
+        dirtySectors.assign(numSets * numWays, 0);
+    }
+    
+    //adds every array and the generator state to a checkpoint, in the order Restore() reads them
+    template <class Writer>
+    void Save(Writer & checkpoint) const
+    {
+        checkpoint.AddVector(tagLines);
+        checkpoint.AddVector(validBits);
+        checkpoint.AddVector(dirtyBits);
+        checkpoint.AddVector(prefetchBits);
+        checkpoint.AddVector(lruCounters);
+        checkpoint.AddVector(setStates);
+        checkpoint.AddVector(validSectors);
+        checkpoint.AddVector(dirtySectors);
+        checkpoint.AddValue(randomState);
+    }
+    
+    //reads what Save() wrote into storage of the same geometry; returns FALSE if the checkpoint does not fit
+    template <class Reader>
+    bool Restore(Reader & checkpoint)
+    {
+        return checkpoint.ReadVector(tagLines) && checkpoint.ReadVector(validBits) && checkpoint.ReadVector(dirtyBits) &&
+               checkpoint.ReadVector(prefetchBits) && checkpoint.ReadVector(lruCounters) &&
+               checkpoint.ReadVector(setStates) && checkpoint.ReadVector(validSectors) &&
+               checkpoint.ReadVector(dirtySectors) && checkpoint.ReadValue(randomState);
+    }
+    
+    //returns the tags of a set, tagStride entries long
+    const CacheTag * SetTags(size_t set) const
+    {
+        return reinterpret_cast<const CacheTag *>(tagLines.data()) + set * tagStride;
+    }
+    
+    CacheTag Tag(size_t set, size_t way) const
+    {
+        return SetTags(set)[way];
+    }
+    
+    void SetTag(size_t set, size_t way, CacheTag tag)
+    {
+        reinterpret_cast<CacheTag *>(tagLines.data())[set * tagStride + way] = tag;
+    }
+    
+    //returns the valid bits of a set, bit n for way n
+    unsigned char ValidMask(size_t set) const
+    {
+        return validBits[set];
+    }
+    
+    bool IsValid(size_t set, size_t way) const
+    {
+        return (validBits[set] >> way) & 1;
+    }
+    
+    void SetValid(size_t set, size_t way)
+    {
+        validBits[set] |= static_cast<unsigned char>(1 << way);
+    }
+    
+    //drops the line in way; its tag and replacement state are left as they are
+    void ClearValid(size_t set, size_t way)
+    {
+        validBits[set] &= static_cast<unsigned char>(~(1 << way));
+    }
+    
+    bool IsDirty(size_t set, size_t way) const
+    {
+        return (dirtyBits[set] >> way) & 1;
+    }
+    
+    void SetDirty(size_t set, size_t way, bool dirty)
+    {
+        if (dirty)
+            dirtyBits[set] |= static_cast<unsigned char>(1 << way);
+        else
+            dirtyBits[set] &= static_cast<unsigned char>(~(1 << way));
+    }
+    
+    bool IsPrefetched(size_t set, size_t way) const
+    {
+        return (prefetchBits[set] >> way) & 1;
+    }
+    
+    void SetPrefetched(size_t set, size_t way, bool prefetched)
+    {
+        if (prefetched)
+            prefetchBits[set] |= static_cast<unsigned char>(1 << way);
+        else
+            prefetchBits[set] &= static_cast<unsigned char>(~(1 << way));
+    }
+    
+    unsigned char & LRU(size_t set, size_t way)
+    {
+        return lruCounters[set * numWays + way];
+    }
+    
+    unsigned char LRU(size_t set, size_t way) const
+    {
+        return lruCounters[set * numWays + way];
+    }
+    
+    //per-way replacement byte for policies other than LRU (shares the LRU counter array)
+    unsigned char & WayState(size_t set, size_t way)
+    {
+        return lruCounters[set * numWays + way];
+    }
+    
+    //per-set replacement byte: tree bits, reference bits or an insertion pointer, depending on the policy
+    unsigned char & SetState(size_t set)
+    {
+        return setStates[set];
+    }
+    
+    //sectors of the line in way that hold data, bit n for sector n (sectored caches only)
+    unsigned int & ValidSectors(size_t set, size_t way)
+    {
+        return validSectors[set * numWays + way];
+    }
+    
+    //sectors of the line in way written since they were filled (sectored caches only)
+    unsigned int & DirtySectors(size_t set, size_t way)
+    {
+        return dirtySectors[set * numWays + way];
+    }
+    
+    //returns the next value of this cache's xorshift generator
+    unsigned int NextRandom()
+    {
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState;
+    }
+    
+    size_t Sets() const
+    {
+        return numSets;
+    }
+    
+    size_t Ways() const
+    {
+        return numWays;
+    }
+    
+private:
+    template <size_t WAYS> friend class CacheStorageView;
+    
+    //one cache line of tags; the vector hands out line-aligned storage
+    struct alignas(64) TagLine
+    {
+        CacheTag tag[8];
+    };
+    
+    size_t numSets;
+    size_t numWays;
+    size_t tagStride; //ways rounded up to a power of two
+    std::vector<TagLine> tagLines;
+    std::vector<unsigned char> validBits;
+    std::vector<unsigned char> dirtyBits;
+    std::vector<unsigned char> prefetchBits;
+    std::vector<unsigned char> lruCounters;
+    std::vector<unsigned char> setStates;
+    std::vector<unsigned int> validSectors;
+    std::vector<unsigned int> dirtySectors;
+    unsigned int randomState;
+    
+}; //end class CacheStorage
+
+
+//Returns the smallest power of two that is at least n
+constexpr size_t PowerOfTwoCeiling(size_t n)
+{
+    return (n <= 1) ? 1 : 2 * PowerOfTwoCeiling((n + 1) / 2);
+}
+
+//A CacheStorage seen through a number of ways fixed at compile time.  Ways() and the tag stride are constants, so
+//loops over the ways have a constant trip count and unroll, and the per-way arrays are indexed without a multiply
+//by a variable.  WAYS of 0 is the generic view, which reads the ways from the storage.
+template <size_t WAYS>
+class CacheStorageView
+{
+public:
+    explicit CacheStorageView(CacheStorage & storage)
+        : storage(storage)
+    {
+    }
+    
+    const CacheTag * SetTags(size_t set) const
+    {
+        return reinterpret_cast<const CacheTag *>(storage.tagLines.data()) + set * TagStride();
+    }
+    
+    void SetTag(size_t set, size_t way, CacheTag tag)
+    {
+        reinterpret_cast<CacheTag *>(storage.tagLines.data())[set * TagStride() + way] = tag;
+    }
+    
+    unsigned char ValidMask(size_t set) const
+    {
+        return storage.validBits[set];
+    }
+    
+    void SetValid(size_t set, size_t way)
+    {
+        storage.validBits[set] |= static_cast<unsigned char>(1 << way);
+    }
+    
+    void ClearValid(size_t set, size_t way)
+    {
+        storage.validBits[set] &= static_cast<unsigned char>(~(1 << way));
+    }
+    
+    bool IsDirty(size_t set, size_t way) const
+    {
+        return (storage.dirtyBits[set] >> way) & 1;
+    }
+    
+    void SetDirty(size_t set, size_t way, bool dirty)
+    {
+        if (dirty)
+            storage.dirtyBits[set] |= static_cast<unsigned char>(1 << way);
+        else
+            storage.dirtyBits[set] &= static_cast<unsigned char>(~(1 << way));
+    }
+    
+    bool IsPrefetched(size_t set, size_t way) const
+    {
+        return (storage.prefetchBits[set] >> way) & 1;
+    }
+    
+    void SetPrefetched(size_t set, size_t way, bool prefetched)
+    {
+        if (prefetched)
+            storage.prefetchBits[set] |= static_cast<unsigned char>(1 << way);
+        else
+            storage.prefetchBits[set] &= static_cast<unsigned char>(~(1 << way));
+    }
+    
+    unsigned char & LRU(size_t set, size_t way)
+    {
+        return storage.lruCounters[set * Ways() + way];
+    }
+    
+    unsigned char & WayState(size_t set, size_t way)
+    {
+        return storage.lruCounters[set * Ways() + way];
+    }
+    
+    unsigned char & SetState(size_t set)
+    {
+        return storage.setStates[set];
+    }
+    
+    unsigned int & ValidSectors(size_t set, size_t way)
+    {
+        return storage.validSectors[set * Ways() + way];
+    }
+    
+    unsigned int & DirtySectors(size_t set, size_t way)
+    {
+        return storage.dirtySectors[set * Ways() + way];
+    }
+    
+    unsigned int NextRandom()
+    {
+        return storage.NextRandom();
+    }
+    
+    size_t Ways() const
+    {
+        return (WAYS != 0) ? WAYS : storage.numWays;
+    }
+    
+private:
+    size_t TagStride() const
+    {
+        return (WAYS != 0) ? PowerOfTwoCeiling(WAYS) : storage.tagStride;
+    }
+    
+    CacheStorage & storage;
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Binary checkpoints of the simulated caches.
+
+ A checkpoint is a CheckpointHeader followed by sections, all in the byte order of the machine that wrote it.  Each
+ section is a byte count followed by that many bytes of one array or counter, so a reader can check every section
+ against the array it is about to fill; a checkpoint of another geometry fails on the first section that differs.
+ The simulator decides what the sections are.  Readers map the whole file with mmap and copy each section straight
+ into place, so restoring even the largest caches takes a few milliseconds.
+
+    offset  size  field
+    0       4     magic "MDCS"
+    4       4     version (CHECKPOINT_VERSION)
+    8       8     trace references simulated when the checkpoint was written
+    16      ...   sections: byte count (8), bytes
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char CHECKPOINT_MAGIC[4] = {'M', 'D', 'C', 'S'};
+const uint32_t CHECKPOINT_VERSION = 2; //2: tags are stored 64 bits wide
+
+struct CheckpointHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t references;
+};
+
+//Collects the sections of a checkpoint and writes them out as one file
+class CheckpointWriter
+{
+public:
+    void AddSection(const void *data, size_t size)
+    {
+        uint64_t sectionSize = size;
+        Append(&sectionSize, sizeof(sectionSize));
+        Append(data, size);
+    }
+
+    template <class T>
+    void AddValue(const T & value)
+    {
+        AddSection(&value, sizeof(value));
+    }
+
+    template <class T>
+    void AddVector(const std::vector<T> & values)
+    {
+        AddSection(values.data(), values.size() * sizeof(T));
+    }
+
+    //Writes the checkpoint to a temporary file and renames it over fileName, so an interrupted write never
+    //leaves a damaged checkpoint behind.  Exits on any error, like the rest of the simulator.
+    void Write(const char *fileName, uint64_t references) const
+    {
+        CheckpointHeader header;
+        memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.references = references;
+
+        std::string temporaryName = std::string(fileName) + ".tmp";
+        FILE *checkpointFile = fopen(temporaryName.c_str(), "wb");
+        bool written = checkpointFile != NULL &&
+                       fwrite(&header, sizeof(header), 1, checkpointFile) == 1 &&
+                       fwrite(bytes.data(), 1, bytes.size(), checkpointFile) == bytes.size();
+        if (checkpointFile != NULL && fclose(checkpointFile) != 0)
+            written = false;
+        if (!written || rename(temporaryName.c_str(), fileName) != 0)
+        {
+            std::cerr << "Cannot write checkpoint " << fileName << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+
+private:
+    void Append(const void *data, size_t size)
+    {
+        const char *first = static_cast<const char *>(data);
+        bytes.insert(bytes.end(), first, first + size);
+    }
+
+    std::vector<char> bytes;
+};
+
+//A checkpoint mapped into memory, read one section at a time in the order they were added
+class CheckpointReader
+{
+public:
+    CheckpointReader()
+        : mapping(NULL), mappingSize(0), position(0)
+    {
+    }
+
+    ~CheckpointReader()
+    {
+        if (mapping != NULL)
+            munmap(mapping, mappingSize);
+    }
+
+    //Maps a checkpoint read-only and checks its header.  Exits on any error.
+    void Open(const char *fileName)
+    {
+        int checkpointFd = open(fileName, O_RDONLY);
+        struct stat checkpointStat;
+        if (checkpointFd < 0 || fstat(checkpointFd, &checkpointStat) != 0)
+        {
+            std::cerr << "Cannot read checkpoint " << fileName << "\n";
+            exit(EXIT_FAILURE);
+        }
+
+        mappingSize = static_cast<size_t>(checkpointStat.st_size);
+        mapping = (mappingSize >= sizeof(CheckpointHeader)) ?
+            mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, checkpointFd, 0) : NULL;
+        close(checkpointFd); //the mapping keeps its own reference to the file
+        if (mapping == NULL || mapping == MAP_FAILED)
+        {
+            mapping = NULL;
+            std::cerr << "Cannot map checkpoint " << fileName << "\n";
+            exit(EXIT_FAILURE);
+        }
+
+        const CheckpointHeader *header = static_cast<const CheckpointHeader *>(mapping);
+        if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || header->version != CHECKPOINT_VERSION)
+        {
+            std::cerr << "Checkpoint " << fileName << " has an unsupported format or version.\n";
+            exit(EXIT_FAILURE);
+        }
+        position = sizeof(CheckpointHeader);
+    }
+
+    uint64_t References() const
+    {
+        return static_cast<const CheckpointHeader *>(mapping)->references;
+    }
+
+    //Copies the next section into data.  Returns FALSE, and copies nothing, if it is not exactly size bytes.
+    bool ReadSection(void *data, size_t size)
+    {
+        const char *base = static_cast<const char *>(mapping);
+        uint64_t sectionSize;
+        if (mappingSize - position < sizeof(sectionSize))
+            return false;
+        memcpy(&sectionSize, base + position, sizeof(sectionSize));
+        if (sectionSize != size || mappingSize - position - sizeof(sectionSize) < size)
+            return false;
+        if (size > 0)
+            memcpy(data, base + position + sizeof(sectionSize), size);
+        position += sizeof(sectionSize) + size;
+        return true;
+    }
+
+    template <class T>
+    bool ReadValue(T & value)
+    {
+        return ReadSection(&value, sizeof(value));
+    }
+
+    //fills values, which must already have the size of the saved array
+    template <class T>
+    bool ReadVector(std::vector<T> & values)
+    {
+        return ReadSection(values.data(), values.size() * sizeof(T));
+    }
+
+    //returns TRUE if every section has been read
+    bool AtEnd() const
+    {
+        return position == mappingSize;
+    }
+
+private:
+    void *mapping;
+    size_t mappingSize;
+    size_t position;
+};
+
+#endif
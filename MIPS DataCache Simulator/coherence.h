@@ -0,0 +1,384 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Multi-core support: the pieces of a run with one private data cache per core, kept coherent by a snooping MESI or
+ MOESI protocol.
+
+ Each trace reference names the core that made it (traceparser.h).  A core's line states are kept in its cache's
+ valid and dirty bits plus a shared bit per way:
+
+    state   valid dirty shared
+    M       1     1     0       the only copy, modified
+    O       1     1     1       modified and shared; this copy answers for it (MOESI only)
+    E       1     0     0       the only copy, clean
+    S       1     0     1       one of several clean copies
+    I       0
+
+ Which accesses can be simulated in parallel follows from the first-touch owner of every line.  While only one
+ core has ever touched a line, no other cache can hold it, so that core's accesses to it need no snooping and
+ change nothing outside its own cache.  Runs of such private accesses are shared out between worker threads, one
+ group of cores each; an access to a line two cores have touched is simulated on its own, in trace order, with
+ every other cache snooped.  Results are the same for any number of threads.
+
+ Coherence misses are misses on a line the core lost to another core's invalidation.  The bytes written by other
+ cores since then are tracked per line, in up to 64 chunks; a coherence miss that touches none of them is a false
+ sharing miss, which padding or realigning the data would remove.
+ */
+
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum CoherenceProtocol
+{
+    PROTOCOL_MESI,
+    PROTOCOL_MOESI //a read of a modified line leaves it dirty with its owner instead of writing it back
+};
+
+//Converts a protocol name from trace.config.  Returns FALSE if the name is not known.
+inline bool ParseCoherenceProtocol(const std::string & name, CoherenceProtocol & protocol)
+{
+    if (strcasecmp(name.c_str(), "MESI") == 0)
+        protocol = PROTOCOL_MESI;
+    else if (strcasecmp(name.c_str(), "MOESI") == 0)
+        protocol = PROTOCOL_MOESI;
+    else
+        return false;
+    return true;
+}
+
+inline const char * CoherenceProtocolName(CoherenceProtocol protocol)
+{
+    return (protocol == PROTOCOL_MOESI) ? "MOESI" : "MESI";
+}
+
+enum CoherenceState
+{
+    COHERENCE_INVALID,
+    COHERENCE_SHARED,
+    COHERENCE_EXCLUSIVE,
+    COHERENCE_OWNED,
+    COHERENCE_MODIFIED
+};
+
+//One line's worth of a reference of one core; a reference that crosses a line boundary is one access per line
+struct CoreAccess
+{
+    uint64_t address;
+    unsigned short core;
+    unsigned char dataSize;
+    char mode;
+    bool shared; //another core touched the line before this access, so the other caches have to be snooped
+};
+
+//Bus and memory counters of one core
+struct CoreCounters
+{
+    CoreCounters()
+        : busReads(0), busReadExclusives(0), busUpgrades(0), cacheToCache(0), memoryReads(0), memoryWrites(0),
+          coherenceMisses(0), falseSharingMisses(0)
+    {
+    }
+
+    size_t busReads; //read misses
+    size_t busReadExclusives; //write misses, which invalidate every other copy
+    size_t busUpgrades; //writes to an S or O line, which invalidate every other copy
+    size_t cacheToCache; //misses another cache answered with its dirty copy
+    size_t memoryReads; //misses main memory answered
+    size_t memoryWrites; //dirty lines written back, on eviction or, in MESI, when another core reads them
+    size_t coherenceMisses;
+    size_t falseSharingMisses;
+};
+
+const unsigned char NO_LINE_OWNER = 0xFF;
+const unsigned char SHARED_LINE_OWNER = 0xFE; //core numbers stay below this
+
+//Remembers which core touched each line first, or that more than one has.  A byte per line, in pages that are
+//allocated when first touched, so memory follows the footprint of the trace.  The pages of the 32-bit address space
+//are found in a table, those of lines above it through a hash map.
+class LineOwnerTable
+{
+public:
+    //forgets every line; lineShift is log2 of the line size, which sets the pages of the 32-bit address space
+    void Reset(unsigned int lineShift)
+    {
+        size_t lineBits = 32 - lineShift;
+        size_t pageCount = (lineBits > PAGE_SHIFT) ? (size_t(1) << (lineBits - PAGE_SHIFT)) : 1;
+        pages.assign(pageCount, std::vector<unsigned char>());
+        highPages.clear();
+    }
+
+    //records that core touched line; returns TRUE while no other core has touched it
+    bool Touch(uint64_t line, unsigned int core)
+    {
+        uint64_t pageNumber = line >> PAGE_SHIFT;
+        std::vector<unsigned char> & page = (pageNumber < pages.size()) ? pages[pageNumber] : highPages[pageNumber];
+        if (page.empty())
+            page.assign(size_t(1) << PAGE_SHIFT, NO_LINE_OWNER);
+        unsigned char & owner = page[line & ((1u << PAGE_SHIFT) - 1)];
+        if (owner == NO_LINE_OWNER)
+            owner = static_cast<unsigned char>(core);
+        else if (owner != core)
+            owner = SHARED_LINE_OWNER;
+        return owner == core;
+    }
+
+private:
+    static const unsigned int PAGE_SHIFT = 16; //lines per page as a power of two, 64 KiB of owners
+
+    std::vector<std::vector<unsigned char> > pages;
+    std::unordered_map<uint64_t, std::vector<unsigned char> > highPages; //pages above the 32-bit address space
+};
+
+//Counters of one line that more than one core touched
+struct LineSharing
+{
+    LineSharing()
+        : cores(0), invalidations(0), coherenceMisses(0), falseSharingMisses(0)
+    {
+    }
+
+    uint64_t cores; //bit n for core n
+    uint64_t invalidations;
+    uint64_t coherenceMisses;
+    uint64_t falseSharingMisses;
+};
+
+//Follows the lines more than one core touched: which cores lost which lines to an invalidation, what the other
+//cores wrote to them since, and the per-line counters.  Only shared accesses reach it, one at a time.
+class SharingTracker
+{
+public:
+    //lineShift is log2 of the line size; a line is tracked in up to 64 chunks
+    void Configure(size_t cores, unsigned int lineShift)
+    {
+        lostLines.assign(cores, std::unordered_map<uint64_t, uint64_t>());
+        lines.clear();
+        chunkShift = (lineShift > 6) ? lineShift - 6 : 0;
+        offsetMask = (1u << lineShift) - 1;
+    }
+
+    //returns the chunks of its line that the bytes [address, address + dataSize) fall in
+    uint64_t ChunkMask(uint64_t address, unsigned int dataSize) const
+    {
+        unsigned int offset = static_cast<unsigned int>(address & offsetMask);
+        unsigned int first = offset >> chunkShift;
+        unsigned int last = (offset + dataSize - 1) >> chunkShift;
+        uint64_t upToLast = (last >= 63) ? ~uint64_t(0) : (uint64_t(2) << last) - 1;
+        return upToLast & ~((uint64_t(1) << first) - 1);
+    }
+
+    void Touch(unsigned int core, uint64_t line)
+    {
+        lines[line].cores |= uint64_t(1) << core;
+    }
+
+    //core's copy of line was invalidated by another core's write
+    void Invalidated(unsigned int core, uint64_t line)
+    {
+        lostLines[core][line] = 0;
+        ++lines[line].invalidations;
+    }
+
+    //writer wrote the given chunks of line; every core that lost the line sees them as written by someone else
+    void Written(unsigned int writer, uint64_t line, uint64_t chunks)
+    {
+        for (size_t core = 0; core < lostLines.size(); ++core)
+        {
+            if (core == writer)
+                continue;
+            std::unordered_map<uint64_t, uint64_t>::iterator lost = lostLines[core].find(line);
+            if (lost != lostLines[core].end())
+                lost->second |= chunks;
+        }
+    }
+
+    //A miss of core on line, touching the given chunks.  Returns TRUE if it is a coherence miss, and sets
+    //falseSharing when none of the chunks it touches was written since the line was lost.
+    bool Miss(unsigned int core, uint64_t line, uint64_t chunks, bool & falseSharing)
+    {
+        std::unordered_map<uint64_t, uint64_t>::iterator lost = lostLines[core].find(line);
+        if (lost == lostLines[core].end())
+            return false;
+        falseSharing = (lost->second & chunks) == 0;
+        lostLines[core].erase(lost);
+        LineSharing & sharing = lines[line];
+        ++sharing.coherenceMisses;
+        sharing.falseSharingMisses += falseSharing;
+        return true;
+    }
+
+    //returns up to count lines with invalidations, most false sharing misses first, then most coherence misses,
+    //then most invalidations
+    std::vector<std::pair<uint64_t, LineSharing> > Hotspots(size_t count) const
+    {
+        std::vector<std::pair<uint64_t, LineSharing> > hotspots;
+        for (std::unordered_map<uint64_t, LineSharing>::const_iterator line = lines.begin(); line != lines.end(); ++line)
+        {
+            if (line->second.invalidations > 0)
+                hotspots.push_back(*line);
+        }
+        std::sort(hotspots.begin(), hotspots.end(), HotterLine);
+        if (hotspots.size() > count)
+            hotspots.resize(count);
+        return hotspots;
+    }
+
+    //Writes every shared line, in address order, as CSV or JSON.  lineShift turns line numbers into addresses.
+    void Write(std::ostream & out, bool json, unsigned int lineShift) const
+    {
+        std::vector<std::pair<uint64_t, LineSharing> > sorted(lines.begin(), lines.end());
+        std::sort(sorted.begin(), sorted.end(), LowerLine);
+
+        if (json)
+            out << "{\n  \"lines\": [\n";
+        else
+            out << "line_address,cores,invalidations,coherence_misses,false_sharing_misses\n";
+        for (size_t i = 0; i < sorted.size(); ++i)
+        {
+            const LineSharing & sharing = sorted[i].second;
+            uint64_t address = sorted[i].first << lineShift;
+            if (json)
+            {
+                out << "    {\"lineAddress\": " << address << ", \"cores\": [" << CoreList(sharing.cores, ", ") <<
+                    "], \"invalidations\": " << sharing.invalidations << ", \"coherenceMisses\": " <<
+                    sharing.coherenceMisses << ", \"falseSharingMisses\": " << sharing.falseSharingMisses << "}" <<
+                    ((i + 1 < sorted.size()) ? ",\n" : "\n");
+            }
+            else
+            {
+                out << "0x" << std::hex << address << std::dec << "," << CoreList(sharing.cores, " ") << "," <<
+                    sharing.invalidations << "," << sharing.coherenceMisses << "," << sharing.falseSharingMisses << "\n";
+            }
+        }
+        if (json)
+            out << "  ]\n}\n";
+    }
+
+    //returns the cores of a bit mask as a list, e.g. "0 2 3"
+    static std::string CoreList(uint64_t cores, const char *separator)
+    {
+        std::string list;
+        for (unsigned int core = 0; core < 64; ++core)
+        {
+            if (!((cores >> core) & 1))
+                continue;
+            if (!list.empty())
+                list += separator;
+            list += std::to_string(core);
+        }
+        return list;
+    }
+
+private:
+    static bool HotterLine(const std::pair<uint64_t, LineSharing> & a, const std::pair<uint64_t, LineSharing> & b)
+    {
+        if (a.second.falseSharingMisses != b.second.falseSharingMisses)
+            return a.second.falseSharingMisses > b.second.falseSharingMisses;
+        if (a.second.coherenceMisses != b.second.coherenceMisses)
+            return a.second.coherenceMisses > b.second.coherenceMisses;
+        if (a.second.invalidations != b.second.invalidations)
+            return a.second.invalidations > b.second.invalidations;
+        return a.first < b.first;
+    }
+
+    static bool LowerLine(const std::pair<uint64_t, LineSharing> & a, const std::pair<uint64_t, LineSharing> & b)
+    {
+        return a.first < b.first;
+    }
+
+    std::vector<std::unordered_map<uint64_t, uint64_t> > lostLines; //per core: lines lost to an invalidation, and the chunks others wrote since
+    std::unordered_map<uint64_t, LineSharing> lines;
+    unsigned int chunkShift; //log2 of the bytes per chunk
+    unsigned int offsetMask;
+};
+
+//Hands a run of private accesses from the trace reader to the core worker threads and waits until every worker
+//has simulated its share.  The reader is worker 0 and takes its share itself.  Publishing a run bumps a
+//generation counter; each worker bumps its own count when it is done.  Waiting threads spin and yield, as in the
+//reference queue of a sweep.
+class CoreRunDispatcher
+{
+public:
+    CoreRunDispatcher(size_t workers)
+        : finished(workers), run(NULL), runLength(0)
+    {
+        generation.store(0);
+        closed.store(false);
+        for (size_t i = 0; i < finished.size(); ++i)
+            finished[i].value.store(0);
+    }
+
+    //publishes a run; the accesses must stay in place until Wait() returns
+    void Start(const CoreAccess *accesses, size_t count)
+    {
+        run = accesses;
+        runLength = count;
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+    //waits until every other worker has finished the run published last
+    void Wait()
+    {
+        uint64_t target = generation.load(std::memory_order_relaxed);
+        for (size_t worker = 1; worker < finished.size(); ++worker)
+        {
+            while (finished[worker].value.load(std::memory_order_acquire) < target)
+                std::this_thread::yield();
+        }
+    }
+
+    //tells the workers that no more runs will be published
+    void Close()
+    {
+        closed.store(true, std::memory_order_release);
+    }
+
+    //waits for the next run for a worker; returns FALSE once the dispatcher is closed
+    bool Next(size_t worker, const CoreAccess *& accesses, size_t & count)
+    {
+        uint64_t next = finished[worker].value.load(std::memory_order_relaxed) + 1;
+        while (generation.load(std::memory_order_acquire) < next)
+        {
+            if (closed.load(std::memory_order_acquire))
+                return false;
+            std::this_thread::yield();
+        }
+        accesses = run;
+        count = runLength;
+        return true;
+    }
+
+    //a worker has simulated its share of the run returned by Next()
+    void Done(size_t worker)
+    {
+        finished[worker].value.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    //a counter alone on its cache line, so workers do not slow each other down
+    struct alignas(64) PaddedCounter
+    {
+        std::atomic<uint64_t> value;
+    };
+
+    std::vector<PaddedCounter> finished;
+    alignas(64) std::atomic<uint64_t> generation;
+    std::atomic<bool> closed;
+    const CoreAccess *run;
+    size_t runLength;
+};
+
+#endif
@@ -7,15 +7,71 @@
  
  1) Reads the configuration file using the ReadConfig() function to determine the set configuration and line size.
  2) Prints the configuration using the PrintConfig() function.
- 3) Builds the sets assuming the maximum number and associativity. The program may or may not use all of them depending on the configuration.
- 4) Enteres the main loop and interprets the data line by line.  Note that the data is extraced once from the cin stream and then stored in an 
-    array "TraceDat" for future use.
+ 3) Builds the sets for the configured number of sets and associativity.  Storage is set-major: the tags of a set are
+    contiguous and the valid, dirty and replacement state are kept in separate packed arrays.  The replacement policy
+    (LRU unless trace.config names another) is a template parameter of the simulation loop.  The access code is also
+    compiled once for every associativity from 1 to MAX_ASSOCIATIVITY, and each cache uses the copy for its ways.
+ 4) Enteres the main loop and interprets the data line by line.  By default stdin is read in large chunks and each reference is
+    simulated as soon as its line is complete, so memory use does not grow with the trace.  With --buffered the data is extraced
+    once from the cin stream and then stored in an array "TraceDat" for future use.  --trace reads a file instead of stdin;
+    binary traces produced by traceconvert are memory mapped, and their records go through the same checks.
  5) Outputs an error to cerr if a size or alignment problem is detected.  In this case no counters are incremented.
- 5) Outputs each line based on the results and increments the appropriate counters (hit or miss) as well as the access counter.
+ 6) With further levels in trace.config, every data cache miss and every line it replaces goes on to L2 and below,
+    following the configured inclusion policy, and the summary adds the statistics of every level and the traffic
+    to main memory.  The Memrefs column still counts the data cache's references to the level below it.
+    Stores are write-back and write-allocate unless trace.config selects write-through or no-write-allocate, and an
+    optional write buffer combines the lines written below; Memrefs then counts only what left the buffer.
+    A "Sector size" line splits every line into sectors with their own valid and dirty bits, so fills and write
+    backs move only the sectors a reference touched, and the summary reports the bytes moved to and from memory.
+    A reference that runs past the end of a line is simulated, and printed, as one access per line it touches.
+    A "Prefetcher" line adds a next-line, stride or stream prefetcher.  It trains on the data cache's misses and the
+    first use of each line it fetched, fills its lines through the data cache's sets and replacement policy, and the
+    summary reports its accuracy, coverage, timeliness and traffic.  Memrefs counts demand traffic only.
+ 7) Outputs each line based on the results and increments the appropriate counters (hit or miss) as well as the access counter.
+    The rows are formatted by hand into a large output buffer that sits under std::cout and is written out in blocks.
+    --summary-only skips the rows and prints just the configuration and the summary.
+    --classify-misses also runs a first-touch set and a fully associative LRU cache of the same size beside the data
+    cache, adds a column naming every miss compulsory, capacity or conflict, and adds the three totals to the summary.
+    --set-stats writes the accesses, misses and evictions of every set of the data cache to a CSV or JSON file at the
+    end, and --interval with --interval-stats writes the misses of every interval of that many accesses.
+ 8) --save-state writes a binary checkpoint of every cache, its contents, replacement state and counters, at the end
+    of the trace, and with --save-every also after every so many references.  --load-state restores one and passes
+    over the references it already covers, so an interrupted run, or a trace that has grown since, continues where
+    the checkpoint stopped.  --warm-state restores only the cache contents, so one trace can warm the cache that
+    another trace is measured on.
+ 9) --sample-sets and --sample-time simulate a sample of the data cache's sets, or periodic windows of the trace
+    with a warm-up before each, instead of every reference.  Accesses to sets outside the sample are dropped once
+    their index is known, before any tag work.  The summary then extrapolates the hit and miss ratios and gives
+    95% confidence intervals for them.
+ 
+ With --sweep the trace is decoded once and every reference is fed to one independent cache per listed configuration.
+ No per-reference lines are printed; the summary statistics of each configuration are printed as a table at the end.
+ --threads N shares the configurations of a sweep between N worker threads.  The main thread decodes the trace into
+ batches that every worker reads, and each configuration is simulated by exactly one worker in trace order, so the
+ results do not depend on the number of threads.
+ 
+ With "Cores: n" in trace.config every core gets a private data cache of the configured geometry, and the cores named
+ in the trace ("R:4:58:core") are kept coherent by a snooping MESI, or "Coherence: MOESI", protocol.  No per-reference
+ lines are printed; the summary adds each core's counters, the bus and memory traffic, the coherence and false
+ sharing misses and the lines with the most false sharing, and --sharing-stats writes the counters of every line
+ the cores shared.  Accesses to lines only one core has touched need no snooping, so with --threads long runs of
+ them are simulated on several threads; accesses to shared lines are simulated in trace order.
+ 
+ With --stack-distance N the trace is run once through an LRU stack distance model of trace.config's sets and line size
+ instead of a cache, and the hits and misses of every associativity from 1 to N ways are printed as a table.
+
+ The cache model itself is in cachemodel.h and reads none of the globals below: every cache carries its own store
+ handling and probe kernel, which ConfiguredCacheOptions() takes from trace.config and the command line.  This file
+ reads the trace, wires the caches together and prints the results.  cachesim.h wraps the same model as a library,
+ a Cache object that simulates batches of references, for programs that bring their own references.  A single data
+ cache with nothing below it and no write buffer, prefetcher, sectors, write-through, no-write-allocate, statistics,
+ sampling or checkpoints is such a Cache here too: its line accesses are queued and simulated LIBRARY_BATCH_SIZE at
+ a time, and their result lines printed after each batch.  The model
+ takes 64-bit addresses and keeps every tag in full; the trace formats read here hold 32-bit MIPS addresses.
  
  -------------------------------------
  Compilation statement:
- g++ -I. -odatacache_i.x datacache.cpp
+ g++ -I. -pthread -odatacache_i.x datacache.cpp
  -------------------------------------
  
  Note that the code is self-documenting.
@@ -28,502 +84,2639 @@
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <deque>
+#include <memory>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <math.h>
+#include <assert.h>
+
+#include "traceparser.h"
+#include "tracefile.h"
+#include "tagmatch.h"
+#include "cachestorage.h"
+#include "replacement.h"
+#include "cachemodel.h"
+#include "cachesim.h"
+#include "referencequeue.h"
+#include "stackdistance.h"
+#include "outputwriter.h"
+#include "writebuffer.h"
+#include "prefetcher.h"
+#include "missclassifier.h"
+#include "setstats.h"
+#include "checkpoint.h"
+#include "sampling.h"
+#include "coherence.h"
 
 //Variables red from configuation file
 size_t numSets; //set is similar to a block
 size_t associativityLevel;
 size_t lineSize;
+ReplacementPolicy replacementPolicy = POLICY_LRU;
+bool writeThrough = false; //stores also go to the level below and never dirty a line
+bool writeAllocate = true; //a store miss brings the line into the cache
+size_t writeBufferEntries = 0; //lines in the write buffer, 0 for none
+size_t sectorSize = 0; //bytes per sector, 0 if lines are not sectored
+PrefetcherKind prefetcherKind = PREFETCH_NONE;
+size_t prefetchDegree = 1; //lines predicted each time the prefetcher trains
+size_t prefetchLatency = 0; //references a prefetched line takes to arrive
+size_t numCores = 1; //cores with a private data cache each
+CoherenceProtocol coherenceProtocol = PROTOCOL_MESI; //keeps the caches of several cores coherent
 size_t numDataLines;
 
 //Variables for program
 size_t numEntries;
 
+//Program options, set from the command line
+bool bufferedInput = false; //read the whole trace into memory before simulating
+const char *traceFileName = NULL; //read the trace from this file instead of stdin
+TagMatchKernel tagMatch = NULL; //set probe kernel, chosen from the CPU features at startup
+bool verifyTagMatch = false; //cross-check every probe against the scalar kernel
+size_t workerThreads = 1; //threads simulating the configurations of a sweep
+size_t stackDistanceWays = 0; //--stack-distance: report LRU results for 1 to this many ways, 0 if off
+bool summaryOnly = false; //print no per-reference rows
+bool genericKernel = false; //use the access code with run-time ways for every cache
+bool classifyMisses = false; //--classify-misses: split the data cache's misses into compulsory, capacity and conflict
+const char *setStatsFileName = NULL; //--set-stats: write the data cache's per-set counters to this file
+const char *intervalStatsFileName = NULL; //--interval-stats: write the interval samples to this file
+size_t intervalLength = 0; //--interval: data cache accesses per interval sample
+const char *saveStateFileName = NULL; //--save-state: write a checkpoint of the caches to this file
+size_t saveStateInterval = 0; //--save-every: also write it after every this many references, 0 for only at the end
+const char *loadStateFileName = NULL; //--load-state or --warm-state: start from this checkpoint
+bool warmStart = false; //--warm-state: take only the cache contents from the checkpoint, counters start at zero
+size_t setSampleRatio = 0; //--sample-sets: simulate about one set in this many, 0 for every set
+size_t timeSampleWindow = 0; //--sample-time: references measured per window, 0 for no time sampling
+size_t timeSamplePeriod = 0; //references from the start of one window to the next
+size_t timeSampleWarmup = 0; //references simulated uncounted before each window
+const char *sharingStatsFileName = NULL; //--sharing-stats: write the counters of every line several cores shared
+OutputWriter referenceOutput; //block buffer under std::cout, also written directly by PrintReference()
+
 //Program constants; represent the greatest possible extents
 const size_t MAX_SETS = 8192;
 const size_t MAX_ASSOCIATIVITY = 8;
+const size_t MAX_CACHE_LEVELS = 4; //the data cache and up to three levels below it
+const size_t MAX_WRITE_BUFFER_ENTRIES = 64; //the buffer is searched on every write
+const size_t MAX_SECTORS_PER_LINE = 32; //one bit per sector in the sector masks
+const size_t MAX_PREFETCH_DEGREE = 16;
+const size_t MAX_PREFETCH_LATENCY = 256; //in-flight prefetches are searched on every prefetch
+const size_t TRACE_CHUNK_SIZE = 1 << 20; //bytes read from stdin at a time when streaming
+const size_t MAX_CORES = 64; //one bit per core in the sharing statistics
+const size_t CORE_BATCH_SIZE = 1 << 14; //line accesses of a multi-core trace queued before they are simulated
+const size_t LIBRARY_BATCH_SIZE = 4096; //line accesses of a plain data cache queued before they are simulated
+const size_t PARALLEL_RUN_MIN = 1024; //private accesses worth handing to the core workers; shorter runs stay on the reader
+
+
+//Important typeDefs
+typedef CacheStorage setAssociation; //all sets and ways of the cache
+
 
-class CacheBlock
+//How the levels of a hierarchy share lines
+enum InclusionPolicy
 {
-public:
-    //default constructor
-    CacheBlock()
-    {
-        blockData.LRU = 0;
-        blockData.Data = 0;
-        blockData.Tag = 0;
-        blockData.dirtyBit = 0;
-        blockData.validBit = 0;
-    };
-    
-    //constructor with argument
-    CacheBlock(size_t init)
-    {
-        blockData.LRU = init;
-        blockData.Data = init;
-        blockData.Tag = init;
-        blockData.dirtyBit = init;
-        blockData.validBit = init;
-    }
-    
-    //default destructor
-    ~CacheBlock()
-    {};
-    
-    //copy constructor, necessary for vector assignment
-    CacheBlock(const CacheBlock &c2)
-    {
-        blockData.LRU = c2.blockData.LRU;
-        blockData.Data = c2.blockData.Data;
-        blockData.Tag = c2.blockData.Tag;
-        blockData.dirtyBit = c2.blockData.dirtyBit;
-        blockData.validBit = c2.blockData.validBit;
-    }
-    
-    void EraseMembers()
-    {
-        blockData.LRU = 0;
-        blockData.Data = 0;
-        blockData.Tag = 0;
-        blockData.dirtyBit = 0;
-        blockData.validBit = 0;
-    }
-    
-    //establishes a cahceBlock which holds all the relevant data
-    struct {
-        unsigned short LRU;
-        unsigned short Data; //we don't actually care about the data in this simulation
-        unsigned short Tag;
-        unsigned short dirtyBit;
-        unsigned short validBit;
-    } blockData;
-    
-}; //end class CacheBlock
+    INCLUSION_NINE, //non-inclusive non-exclusive: fills go to every level, evictions are independent
+    INCLUSION_INCLUSIVE, //as NINE, and a line leaving a level is removed from every level above it
+    INCLUSION_EXCLUSIVE //a line lives in one level: fills go to the data cache, lower levels hold its victims
+};
+
+//LRU stack distance run over one set count and line size: the recency stack of every set and how many references
+//found their line at each depth
+struct StackDistanceModel
+{
+    CacheGeometry geometry; //associativityLevel is the most ways reported
+    unsigned int offsetShamt;
+    unsigned int indexBitMask;
+    unsigned int indexShamt;
+    std::vector<StackDistanceSet> sets;
+    std::vector<size_t> depthCounter; //references found at depth d, for d up to associativityLevel
+    size_t refCounter;
+};
+
+//A prefetched line on its way to the data cache
+struct PendingPrefetch
+{
+    CacheAddress address; //first address of the line
+    size_t readyAt; //filled before the reference after this many data cache accesses
+};
 
+struct CoherenceModel;
 
-//Important typeDefs
-typedef std::vector<CacheBlock> cacheSet; //vector of cacheBlocks of 8192 sets
-typedef std::vector<cacheSet> setAssociation; //vector of cacheSets
+//Holds the caches fed by the trace.  Normally there is one; a sweep has one per configuration.
+struct SimulationState
+{
+    std::vector<CacheModel> caches;
+    bool printReferences; //print a result line per reference (single cache only)
+    ReferenceBroadcastQueue *referenceQueue; //set while sweep workers run; references are queued instead of simulated
+    ReferenceBatch *pendingBatch; //batch being filled by the trace reader, NULL if none
+    StackDistanceModel *stackDistance; //set in stack distance mode; references go to it instead of the caches
+    std::vector<CacheModel> lowerLevels; //L2 and below when trace.config describes a hierarchy; caches[0] is L1
+    size_t memoryReads; //lines, or groups of sectors, read from main memory
+    size_t memoryWrites; //lines, or groups of sectors, written to main memory
+    size_t memoryReadBytes;
+    size_t memoryWriteBytes;
+    bool tracksTraffic; //a single data cache: its traffic to the level below is followed and counted
+    WriteBuffer writeBuffer; //between the data cache and the level below; no entries if there is none
+    Prefetcher prefetcher; //predicts lines for the data cache; disabled unless trace.config names one
+    std::deque<PendingPrefetch> pendingPrefetches; //issued prefetches on their way to the data cache, oldest first
+    std::vector<uint64_t> predictions; //lines the prefetcher just predicted
+    size_t prefetchIssued; //lines prefetched
+    size_t prefetchUseful; //prefetched lines later used by a demand reference
+    size_t prefetchLate; //demand misses on a line whose prefetch had not arrived
+    MissClassifier *missClassifier; //set with --classify-misses, NULL otherwise
+    SetStatistics *setStatistics; //set with --set-stats or --interval-stats, NULL otherwise
+    size_t tracePosition; //valid references of the trace seen so far, including those a resumed run passes over
+    size_t resumePosition; //references a resumed run passes over because its checkpoint holds them
+    size_t nextCheckpoint; //tracePosition after which the next periodic checkpoint is written, 0 for none
+    Sampler *sampler; //set with --sample-sets or --sample-time, NULL otherwise
+    CoherenceModel *coherence; //set when trace.config has more than one core; references go to it instead of caches
+    std::unique_ptr<Cache> libraryCache; //set for a data cache with nothing below or beside it; references go to it instead of caches
+    std::vector<Ref> libraryRefs; //line accesses waiting for the next batch of libraryCache
+    std::vector<RefResult> libraryResults;
+};
+
+//One core of a multi-core run: its private data cache, the shared bit of every line (set in S and O) and its bus
+//counters.  Aligned so that cores simulated by different workers never share a cache line.
+struct alignas(64) CoherentCore
+{
+    CacheModel cache;
+    std::vector<unsigned char> sharedBits; //one bit per way, a byte per set, as the valid and dirty bits
+    CoreCounters counters;
+};
+
+//The caches of a multi-core run and the line accesses queued for them
+struct CoherenceModel
+{
+    std::vector<CoherentCore> cores;
+    LineOwnerTable owners; //the core that touched each line first, or that several have
+    SharingTracker sharing; //lost lines and per-line counters of the lines several cores touched
+    std::vector<CoreAccess> pending; //line accesses in trace order, not simulated yet
+    CoreRunDispatcher *dispatcher; //set while core workers run, NULL with one thread
+    std::vector<std::thread> workers;
+    size_t privateAccesses; //accesses to lines no other core had touched
+    size_t sharedAccesses;
+    size_t parallelRuns; //runs of private accesses handed to the workers
+};
+
+//One cache level below the data cache
+struct LevelConfig
+{
+    CacheGeometry geometry;
+    ReplacementPolicy policy;
+};
+
+std::vector<CacheGeometry> sweepGeometries; //--sweep: simulate all of these in one pass instead of trace.config's cache
+std::vector<LevelConfig> lowerLevelConfigs; //L2, L3, ... from trace.config; empty for a single cache
+InclusionPolicy inclusionPolicy = INCLUSION_NINE;
 
 
 //Function prototypes
+void ParseOptions(int, char *[]);
 void ReadConfig();
+bool SplitConfigLine(const std::string &, std::string &, std::string &);
 void PrintConfig();
 size_t ReadDataTrace(std::vector<std::string> &);
+template <class Policy> void RunTrace(SimulationState &);
+template <class Policy> void StreamDataTrace(FILE *, SimulationState &);
+template <class Policy> void SimulateBinaryTrace(const char *, SimulationState &);
+template <class Policy> void ProcessTraceLine(const char *, const char *, size_t, TraceFields &, SimulationState &);
+template <class Policy> void SimulateReference(size_t, const TraceFields &, SimulationState &);
+template <class Policy> void SimulateValidReference(const TraceFields &, SimulationState &);
+void AccessReference(CacheModel &, const TraceFields &, AccessResult &);
+void QueueLibraryReference(const TraceFields &, SimulationState &);
+void RunLibraryBatch(SimulationState &);
+void HandleDataCacheTraffic(SimulationState &, const CacheAddress, AccessResult &);
+void ReadBelow(SimulationState &, const CacheAddress, unsigned int);
+void WriteBelow(SimulationState &, const CacheAddress, unsigned int, AccessResult &);
+void WriteLineBelow(SimulationState &, const CacheAddress, unsigned int);
+void FlushWriteBuffer(SimulationState &);
+void HandlePrefetch(SimulationState &, const CacheAddress, const AccessResult &);
+void IssuePrefetch(SimulationState &, const CacheAddress);
+void InstallPrefetches(SimulationState &);
+void FetchFromLevel(SimulationState &, size_t, const CacheAddress, bool &);
+void PassDown(SimulationState &, size_t, const CacheAddress, bool);
+void EvictFromLevel(SimulationState &, size_t, const CacheAddress, bool);
+bool BackInvalidate(SimulationState &, size_t, const CacheAddress);
+bool ParseLevelSetting(const std::string &, const std::string &);
+bool ParseInclusionPolicy(const std::string &, InclusionPolicy &);
+const char * InclusionPolicyName(InclusionPolicy);
+void PrintHierarchySummary(const SimulationState &);
+void PrintMemoryTraffic(const SimulationState &);
+void PrintPrefetchSummary(const SimulationState &);
+template <class Policy> void StartSweepWorkers(SimulationState &, std::vector<std::thread> &);
+template <class Policy> void SweepWorker(SimulationState &, size_t, size_t);
+void QueueReference(const TraceFields &, SimulationState &);
+void FinishSweepWorkers(SimulationState &, std::vector<std::thread> &);
+template <class Policy> void QueueCoreAccesses(const TraceFields &, SimulationState &);
+template <class Policy> void RunCoreAccesses(CoherenceModel &);
+template <class Policy> void RunPrivateAccesses(CoherenceModel &, const CoreAccess *, size_t);
+template <class Policy> void AccessCoreShare(CoherenceModel &, const CoreAccess *, size_t, size_t, size_t);
+template <class Policy> void AccessCoherent(CoherenceModel &, const CoreAccess &);
+template <class Policy> CoherenceState SnoopCore(CoherenceModel &, size_t, CacheAddress, bool);
+bool IsShared(const CoherentCore &, unsigned int, size_t);
+void SetShared(CoherentCore &, unsigned int, size_t, bool);
+template <class Policy> void StartCoreWorkers(CoherenceModel &);
+template <class Policy> void CoreWorker(CoherenceModel &, size_t, size_t);
+void FinishCoreWorkers(CoherenceModel &);
+bool ParseThreadCount(const char *, size_t &);
+bool ParseTimeSampleSpec(const char *);
+void InitStackDistanceModel(StackDistanceModel &, const CacheGeometry &);
+void AccessStackDistance(StackDistanceModel &, const CacheAddress, const unsigned int);
+CacheOptions ConfiguredCacheOptions();
+bool ParseSweepSpec(const std::string &, std::vector<CacheGeometry> &);
+bool ParseSweepRange(const std::string &, bool, size_t, std::vector<size_t> &);
+void PrintReference(size_t, const char, const CacheAddress, const RefResult &, MissClass);
 void ParseDataTrace(size_t);
-void ModeValidityCheck(const char);
-bool SizeCheck(const unsigned int);
-bool AlignmentCheck(const unsigned int,const unsigned int);
-void PrintSummary(size_t,size_t,size_t);
+void PrintSummary(size_t,size_t,size_t,const MissClassifier *);
+void PrintSweepConfig(const SimulationState &);
+void PrintSweepSummary(const SimulationState &);
+void PrintStackDistanceConfig(const StackDistanceModel &);
+void PrintStackDistanceSummary(const StackDistanceModel &);
+void WriteSetStatistics(SetStatistics &, const size_t);
+void CheckpointConfiguration(std::vector<uint64_t> &);
+void SaveCheckpoint(const SimulationState &, const char *);
+void LoadCheckpoint(SimulationState &, const char *, bool);
+void PrintSampledSummary(const SimulationState &);
+void PrintCoherenceSummary(const CoherenceModel &);
+void WriteSharingStatistics(const CoherenceModel &);
 void DumpCache(setAssociation &, size_t);
 
 
 //Begin main program
-int main()
+int main(int argc, char *argv[])
 {
+    ParseOptions(argc, argv);
+    referenceOutput.Install();
+    
     //Establish Configuration
     ReadConfig();
-    PrintConfig();
-    
-    //Reads the Data Trace File and stores it.  Determines how many lines were sucessfully read.
-    std::vector<std::string> traceDat;
-    numDataLines = ReadDataTrace(traceDat);
-    
-    CacheBlock defaultBlock(0); //creates a cache block with all bit fields initialized to 0.
-    setAssociation cacheAssociation(MAX_ASSOCIATIVITY, cacheSet(MAX_SETS,defaultBlock));
-    
-    char            mode;
-    unsigned int    dataSize;
-    unsigned int    address;
-    bool            sizeError;
-    bool            alignmentError;
-    unsigned int    index;
-    unsigned int    offset;
-    unsigned int    tag;
-    size_t          hitCounter = 0;
-    size_t          missCounter = 0;
-    size_t          refCounter = 0; //holds the number of references read
-    
-    //Output header
-    std::cout << "Results for Each Reference\n\n";
-    std::cout << "Ref  Access Address    Tag   Index Offset Result Memrefs\n";
-    std::cout << "---- ------ -------- ------- ----- ------ ------ -------\n";
-
-    //Main program Loop
-    for (size_t programLine = 0; programLine < numDataLines; ++programLine)
-    {
-        sscanf(traceDat[programLine].c_str(),"%c:%d:%x", &mode, &dataSize, &address);
-        
-        //check if mode is 'R' or 'W', exit otherwise
-        ModeValidityCheck(mode);
-        
-        //check if data size is 1,2,4, or 8
-        sizeError = SizeCheck(dataSize);
-        if(sizeError)
-        {
-            std::cerr << "line " << (programLine + 1) << " has illegal size " << dataSize << "\n";
-            continue; //continue to next line
-        }
+    
+    SimulationState state;
+    state.referenceQueue = NULL;
+    state.pendingBatch = NULL;
+    state.stackDistance = NULL;
+    state.memoryReads = 0;
+    state.memoryWrites = 0;
+    state.memoryReadBytes = 0;
+    state.memoryWriteBytes = 0;
+    state.tracksTraffic = false;
+    state.prefetchIssued = 0;
+    state.prefetchUseful = 0;
+    state.prefetchLate = 0;
+    state.missClassifier = NULL;
+    state.setStatistics = NULL;
+    state.tracePosition = 0;
+    state.resumePosition = 0;
+    state.nextCheckpoint = saveStateInterval;
+    state.sampler = NULL;
+    state.coherence = NULL;
+    StackDistanceModel stackDistance;
+    MissClassifier missClassifier;
+    SetStatistics setStatistics;
+    Sampler sampler;
+    CoherenceModel coherence;
+    if (stackDistanceWays > 0)
+    {
+        //One pass gives the LRU results of every associativity, so no cache is built
+        CacheGeometry geometry = {numSets, stackDistanceWays, lineSize};
+        InitStackDistanceModel(stackDistance, geometry);
+        state.stackDistance = &stackDistance;
+        state.printReferences = false;
+        PrintStackDistanceConfig(stackDistance);
+    }
+    else if (numCores > 1)
+    {
+        PrintConfig();
         
-        alignmentError = AlignmentCheck(dataSize, address);
-        if (alignmentError)
+        //Every core gets its own data cache; the trace names the core of each reference
+        CacheGeometry geometry = {numSets, associativityLevel, lineSize};
+        coherence.cores.resize(numCores);
+        for (size_t core = 0; core < numCores; ++core)
         {
-            std::cerr << "line " << (programLine + 1) << " has misaligned reference at address " << std::hex << address << " for size " <<
-                std::dec << dataSize << "\n";
-            continue; //continue to next line
+            InitCacheModel(coherence.cores[core].cache, geometry, ConfiguredCacheOptions());
+            coherence.cores[core].sharedBits.assign(numSets, 0);
         }
+        coherence.owners.Reset(coherence.cores[0].cache.offsetShamt);
+        coherence.sharing.Configure(numCores, coherence.cores[0].cache.offsetShamt);
+        coherence.dispatcher = NULL;
+        coherence.privateAccesses = 0;
+        coherence.sharedAccesses = 0;
+        coherence.parallelRuns = 0;
+        state.coherence = &coherence;
+        state.printReferences = false;
+    }
+    else if (sweepGeometries.empty())
+    {
+        PrintConfig();
         
-        //no size or alignment errors, increment ref Counter
-        ++refCounter;
-
-        //Determine the index, offset, and tag
-        unsigned int tempAddress = address; //to preserve oriignal address value
-        
-        unsigned int offsetBitMask = static_cast<unsigned int>(lineSize - 1);
-        unsigned int offsetShamt = static_cast<unsigned int>(log2(lineSize));
-        offset = tempAddress & offsetBitMask;       //determine offset
-        tempAddress = tempAddress >> offsetShamt;
-        
-        unsigned int indexBitMask = static_cast<unsigned int>(numSets - 1);
-        unsigned int indexShamt = static_cast<unsigned int>(log2(numSets));
-        index = tempAddress & indexBitMask;         //determine index
-        tempAddress = tempAddress >> indexShamt;
-        
-        tag = tempAddress; //determine tag from remaining bits
+        CacheGeometry geometry = {numSets, associativityLevel, lineSize};
+        state.caches.resize(1);
+        InitCacheModel(state.caches[0], geometry, ConfiguredCacheOptions()); //all entries start invalid with every field 0
+        SectorCacheModel(state.caches[0], sectorSize);
+        state.printReferences = !summaryOnly;
+        state.tracksTraffic = true;
+        state.writeBuffer.Resize(writeBufferEntries);
+        state.prefetcher.Configure(prefetcherKind, prefetchDegree, state.caches[0].offsetShamt);
         
-        //Write the result to the cache
-        //We don't need to worry about numSets; this is taken care of by Index.
-        //Line size is irrelevant for this portion
-        //We only have to worry about associativity level
+        //Prefetches and the levels below work on whole lines of the data cache
+        if (!lowerLevelConfigs.empty() || state.prefetcher.Enabled())
+            state.caches[0].lineKernel = SelectLineKernel(replacementPolicy);
         
-        bool isThere = 0;
-        unsigned int memrefs = 0;
-        unsigned int tempTag = 0;
-        bool isValid = 0;
-        size_t hitSet = 0;
+        //Levels below the data cache are only reached by its misses and writes, so their policy is picked per level at run time
+        if (!lowerLevelConfigs.empty())
+        {
+            state.lowerLevels.resize(lowerLevelConfigs.size());
+            for (size_t level = 0; level < lowerLevelConfigs.size(); ++level)
+            {
+                InitCacheModel(state.lowerLevels[level], lowerLevelConfigs[level].geometry, ConfiguredCacheOptions());
+                state.lowerLevels[level].lineKernel = SelectLineKernel(lowerLevelConfigs[level].policy);
+            }
+        }
         
-        //Relevant varibles: mode
-        //                   refCounter
-        //                   hitCounter
-        //                   missCounterisVal
-        //                   memrefs
-        //                   isValid
-        //                   associativityLevel
-        //                   cacheAssociation[index is 0 to (associativityLevel -1)]
+        if (classifyMisses)
+        {
+            missClassifier.Configure(numSets * associativityLevel, state.caches[0].offsetShamt);
+            state.missClassifier = &missClassifier;
+        }
+        if (setStatsFileName != NULL || intervalStatsFileName != NULL)
+        {
+            setStatistics.Configure(numSets, intervalLength);
+            state.setStatistics = &setStatistics;
+        }
         
-        memrefs = 0; //set memrefs to 0 to start with
+        if (loadStateFileName != NULL)
+            LoadCheckpoint(state, loadStateFileName, warmStart);
         
+        //A sampled run is for quick estimates, so it prints no rows
+        if (setSampleRatio > 0 || timeSampleWindow > 0)
+        {
+            if (setSampleRatio > 0)
+                sampler.ConfigureSets(numSets, setSampleRatio);
+            else
+                sampler.ConfigureTime(timeSampleWindow, timeSamplePeriod, timeSampleWarmup);
+            state.sampler = &sampler;
+            state.printReferences = false;
+        }
         
-        //check to see if tag is already in corresponding index. "isThere" tells us if it is a hit or miss
-        for (size_t i = 0; i < associativityLevel; ++i)
+        //A data cache that nothing watches and that only counts its own traffic is the Cache of cachesim.h
+        if (lowerLevelConfigs.empty() && !state.prefetcher.Enabled() && writeBufferEntries == 0 && sectorSize == 0 &&
+            !writeThrough && writeAllocate && !classifyMisses && state.setStatistics == NULL && state.sampler == NULL &&
+            loadStateFileName == NULL && saveStateFileName == NULL && !genericKernel)
         {
-            isValid = (cacheAssociation[i])[index].blockData.validBit;
-            tempTag = (cacheAssociation[i])[index].blockData.Tag;
-            if (isValid && (tempTag == tag))
-            {
-                isThere = 1;
-                hitSet = i;
-            }
+            CacheConfig config = {numSets, associativityLevel, lineSize, replacementPolicy, writeThrough, writeAllocate, sectorSize};
+            state.libraryCache.reset(new Cache(config));
+            state.libraryCache->Model().options = ConfiguredCacheOptions(); //the probe kernel of --probe and --verify-probe
+            state.libraryRefs.reserve(LIBRARY_BATCH_SIZE);
+            state.libraryResults.resize(LIBRARY_BATCH_SIZE);
+            state.caches.clear();
         }
         
-        //HIT**********
-        //Now includes update LRU.
-        if (isThere) //if we found a hit, behavior will vary depending on whether it is a READ or a WRITE
+        //Output header
+        if (state.printReferences)
         {
-            if (mode == 'R' || mode == 'r') //if we are in read mode, memref will be 0.
+            std::cout << "Results for Each Reference\n\n";
+            if (classifyMisses)
             {
-                if (cacheAssociation[hitSet][index].blockData.LRU != (associativityLevel - 1)) //if the LRU bit is not the highest
-                {
-                    unsigned int LRU_Test = cacheAssociation[hitSet][index].blockData.LRU; //get current LRU value
-                    for (size_t i = 0; i < associativityLevel; ++i) //subtract 1 from LRUs that are greater than LRU_Test
-                    {
-                        if (cacheAssociation[i][index].blockData.LRU > LRU_Test)
-                            --(cacheAssociation[i][index].blockData.LRU);
-                    }
-                    cacheAssociation[hitSet][index].blockData.LRU = (associativityLevel - 1); //now, set LRU of hit block to highest
-                }
+                std::cout << "Ref  Access Address    Tag   Index Offset Result Memrefs  Miss class\n";
+                std::cout << "---- ------ -------- ------- ----- ------ ------ ------- -----------\n";
             }
-            
-            else if (mode == 'W' || mode == 'w') // if we are in write mode, memref will be 0.
-            {
-                cacheAssociation[hitSet][index].blockData.dirtyBit = 1; //set dirty bit to 1, since we're writing to the block
-                cacheAssociation[hitSet][index].blockData.validBit = 1; //set valid bit to 1, regardless of previous state
-                cacheAssociation[hitSet][index].blockData.Tag      = tag; //set tag to computed value
-                cacheAssociation[hitSet][index].blockData.Data     = 0; //set data to 0, irrelevant for simulation
-                
-                //Now, determine what the LRU bits should be set to.
-                if (cacheAssociation[hitSet][index].blockData.LRU != (associativityLevel - 1)) //if the LRU bit is not the highest
-                {
-                    unsigned int LRU_Test = cacheAssociation[hitSet][index].blockData.LRU; //get current LRU value
-                    for (size_t i = 0; i < associativityLevel; ++i) //subtract 1 from LRUs that are greater than LRU_Test
-                    {
-                        if (cacheAssociation[i][index].blockData.LRU > LRU_Test)
-                            --(cacheAssociation[i][index].blockData.LRU);
-                    }
-                    cacheAssociation[hitSet][index].blockData.LRU = (associativityLevel - 1); //now, set LRU of hit block to highest
-                }
-            } //else if - write mode
-            
-            else //program should never get here
+            else
             {
-                std::cerr << "A fatal error occurred in HIT where the mode was neither Read nor Write.\n";
-                exit(EXIT_FAILURE);
+                std::cout << "Ref  Access Address    Tag   Index Offset Result Memrefs\n";
+                std::cout << "---- ------ -------- ------- ----- ------ ------ -------\n";
             }
-        } //HIT
-        
-        else //MISS********** - we did not find a match, now determine which to overwrite.  Memref value will vary.
+        }
+    }
+    else
+    {
+        //Every configuration gets its own cache; the trace is decoded once and each reference goes to all of them
+        state.caches.resize(sweepGeometries.size());
+        for (size_t i = 0; i < sweepGeometries.size(); ++i)
+            InitCacheModel(state.caches[i], sweepGeometries[i], ConfiguredCacheOptions());
+        state.printReferences = false;
+        PrintSweepConfig(state);
+    }
+    
+    //The data cache's replacement policy is fixed for the whole run, so it is chosen once here and compiled into the loop
+    switch (replacementPolicy)
+    {
+        case POLICY_LRU:        RunTrace<LruPolicy>(state);      break;
+        case POLICY_TREE_PLRU:  RunTrace<TreePlruPolicy>(state); break;
+        case POLICY_NRU:        RunTrace<NruPolicy>(state);      break;
+        case POLICY_FIFO:       RunTrace<FifoPolicy>(state);     break;
+        case POLICY_RANDOM:     RunTrace<RandomPolicy>(state);   break;
+        case POLICY_SRRIP:      RunTrace<SrripPolicy>(state);    break;
+        case POLICY_BRRIP:      RunTrace<BrripPolicy>(state);    break;
+    }
+    
+    if (state.tracksTraffic)
+        FlushWriteBuffer(state); //lines still waiting at the end of the trace are written out
+    if (saveStateFileName != NULL)
+        SaveCheckpoint(state, saveStateFileName);
+    
+    if (state.stackDistance != NULL)
+        PrintStackDistanceSummary(stackDistance);
+    else if (state.sampler != NULL)
+        PrintSampledSummary(state);
+    else if (state.coherence != NULL)
+    {
+        size_t hits = 0, misses = 0, refs = 0;
+        for (size_t core = 0; core < coherence.cores.size(); ++core)
         {
-            memrefs = 1; //memrefs will be at least 1.
-            
-            if (mode == 'R' || mode == 'r') //if we are in read mode with a miss
-            {
-                size_t indexToUse = 0; //first, determine which index to use.  Assume we start with 0.
-                for (size_t i = 0; i < associativityLevel; ++i)
-                {
-                    if (cacheAssociation[i][index].blockData.LRU == 0)
-                    {
-                        indexToUse = i;
-                        break;  //once 0 is found, break out of loop.
-                    }
-                }
-                
-                if (cacheAssociation[indexToUse][index].blockData.dirtyBit == 1) //if the block we're about to overwrite is dirty
-                {
-                    memrefs = 2; //set memrefs =2
-                    cacheAssociation[indexToUse][index].blockData.dirtyBit = 0; //set dirtyBit back to 0, this is read mode
-                }
-                
-                //Now, update the remaining portions of the block.
-                cacheAssociation[indexToUse][index].blockData.validBit = 1; //in case it is already not 1
-                cacheAssociation[indexToUse][index].blockData.Tag = tag;
-                cacheAssociation[indexToUse][index].blockData.Data = 0; //we don't care about the data
-                
-                //Now, determine what the LRU bits should be set to.
-                for (unsigned int i = 0; i < associativityLevel; ++i)
-                {
-                    if (cacheAssociation[i][index].blockData.LRU > 0) //if the LRU bit is greater than 0
-                        --(cacheAssociation[i][index].blockData.LRU); //subract 1.
-                }
-                
-                //Finally, update the LRU of the replaced block.
-                cacheAssociation[indexToUse][index].blockData.LRU = (associativityLevel - 1); //set max val to associativity level
-            } //MISS - read mode
-            
-            else if (mode == 'W' || mode == 'w') //if we are in write mode with a miss
-            {
-                size_t indexToUse = 0; //first, determine which index to use.  Assume we start with 0.
-                for (size_t i = 0; i < associativityLevel; ++i)
-                {
-                    if (cacheAssociation[i][index].blockData.LRU == 0)
-                    {
-                        indexToUse = i;
-                        break;  //once 0 is found, break out of loop.
-                    }
-                }
-                
-                if (cacheAssociation[indexToUse][index].blockData.dirtyBit == 1) //if the block we're about to overwrite is dirty
-                {
-                    memrefs = 2; //set memrefs =2
-                }
-                
-                cacheAssociation[indexToUse][index].blockData.dirtyBit = 1; //maintain the dirty bit set, as we are writing to the block.
-                
-                //Now, update the remaining portions of the block.
-                cacheAssociation[indexToUse][index].blockData.validBit = 1; //in case it is already not 1
-                cacheAssociation[indexToUse][index].blockData.Tag = tag;
-                cacheAssociation[indexToUse][index].blockData.Data = 0; //we don't care about the data
-                
-                //Now, determine what the LRU bits should be set to.
-                for (unsigned int i = 0; i < associativityLevel; ++i)
-                {
-                    if (cacheAssociation[i][index].blockData.LRU > 0) //if the LRU bit is greater than 0
-                        --(cacheAssociation[i][index].blockData.LRU); //subract 1.
-                }
-                
-                //Finally, update the LRU of the replaced block.
-                cacheAssociation[indexToUse][index].blockData.LRU = (associativityLevel - 1); //set max val to associativity level
-            } //MISS - write mode
-            
-            else //program should never get here
-            {
-                std::cerr << "A fatal error occurred in MISS where the mode was neither R nor W.\n";
-                exit(EXIT_FAILURE);
-            }
-        } //MISS
+            hits += coherence.cores[core].cache.hitCounter;
+            misses += coherence.cores[core].cache.missCounter;
+            refs += coherence.cores[core].cache.refCounter;
+        }
+        PrintSummary(hits, misses, refs, NULL);
+        PrintCoherenceSummary(coherence);
+        if (sharingStatsFileName != NULL)
+            WriteSharingStatistics(coherence);
+    }
+    else if (state.libraryCache != NULL)
+        PrintSummary(state.libraryCache->Hits(), state.libraryCache->Misses(), state.libraryCache->Accesses(), NULL);
+    else if (sweepGeometries.empty())
+    {
+        PrintSummary(state.caches[0].hitCounter,state.caches[0].missCounter,state.caches[0].refCounter,state.missClassifier);
+        if (!state.lowerLevels.empty())
+            PrintHierarchySummary(state);
+        else if (writeThrough || !writeAllocate || writeBufferEntries > 0 || sectorSize != 0 || state.prefetcher.Enabled())
+        {
+            //otherwise the rows tell it all
+            std::cout << "Memory Traffic\n";
+            std::cout << "--------------\n";
+            PrintMemoryTraffic(state);
+        }
+        if (state.prefetcher.Enabled())
+            PrintPrefetchSummary(state);
+        if (state.setStatistics != NULL)
+            WriteSetStatistics(setStatistics, state.caches[0].writebackCounter);
+    }
+    else
+        PrintSweepSummary(state);
+} //end main
+
+
+/* Function Definitions and Implementations */
+
+//Reads the trace from the selected source and simulates it with replacement policy Policy
+template <class Policy>
+void RunTrace(SimulationState & state)
+{
+    for (size_t i = 0; i < state.caches.size(); ++i)
+        state.caches[i].accessKernel = SelectAccessKernel<Policy>(genericKernel ? 0 : state.caches[i].geometry.associativityLevel);
+    
+    //A sweep with several threads hands every reference to the workers instead of simulating it here
+    std::vector<std::thread> workers;
+    if (!state.printReferences && workerThreads > 1 && state.caches.size() > 1)
+        StartSweepWorkers<Policy>(state, workers);
+    if (state.coherence != NULL && workerThreads > 1)
+        StartCoreWorkers<Policy>(*state.coherence);
+    
+    if (traceFileName != NULL && IsBinaryTraceFile(traceFileName))
+    {
+        //Binary traces were validated when converted and are walked straight from the mapped file
+        SimulateBinaryTrace<Policy>(traceFileName, state);
+    }
+    else if (bufferedInput)
+    {
+        //Reads the Data Trace File and stores it.  Determines how many lines were sucessfully read.
+        std::vector<std::string> traceDat;
+        numDataLines = ReadDataTrace(traceDat);
         
-        //output results
-        std::cout << std::right; //right align
-        std::cout << std::setw(4) << refCounter;
-        std::cout << std::setw(7);
-        if (mode == 'R' || mode == 'r')
-            std::cout << "read";
-        if (mode == 'W' || mode == 'w')
-            std::cout << "write";
-        std::cout << std::setw(9) << std::hex << address;
-        std::cout << std::setw(8) << std::hex << tag;
-        std::cout << std::setw(6) << std::dec << index;
-        std::cout << std::setw(7) << offset;
-        std::cout << std::setw(7);
-        if (isThere) //if it was a hit
-        {
-            std::cout << "hit";
-            ++hitCounter;
+        //Main program Loop
+        TraceFields fields = {'\0', 0, 0, 0};
+        for (size_t programLine = 0; programLine < numDataLines; ++programLine)
+        {
+            const std::string & line = traceDat[programLine];
+            ProcessTraceLine<Policy>(line.data(), line.data() + line.size(), programLine + 1, fields, state);
         }
-        else
+    }
+    else
+    {
+        //Reads the trace chunk by chunk and simulates each reference as soon as its line is complete
+        FILE *traceInput = stdin;
+        if (traceFileName != NULL && (traceInput = fopen(traceFileName, "rb")) == NULL)
         {
-            std::cout << "miss";
-            ++missCounter;
+            std::cerr << "Failed to read data file.\n";
+            exit(EXIT_FAILURE);
         }
-        std::cout << std::setw(8) << memrefs;
-        std::cout << "\n"; //newline
+        StreamDataTrace<Policy>(traceInput, state);
+        if (traceInput != stdin)
+            fclose(traceInput);
+    }
+    
+    if (!workers.empty())
+        FinishSweepWorkers(state, workers);
+    if (state.coherence != NULL)
+    {
+        RunCoreAccesses<Policy>(*state.coherence); //the last, partial batch
+        FinishCoreWorkers(*state.coherence);
+    }
+    if (state.libraryCache != NULL)
+        RunLibraryBatch(state); //the last, partial batch
+}
+
+
+
+//Parses the trace line in [lineBegin,lineEnd) and simulates it.
+//Fields that fail to parse keep their previous values, as sscanf did.
+template <class Policy>
+void ProcessTraceLine(const char *lineBegin, const char *lineEnd, size_t lineNumber, TraceFields & fields, SimulationState & state)
+{
+    ParseTraceLine(lineBegin, lineEnd, fields.mode, fields.dataSize, fields.address, fields.core);
+    SimulateReference<Policy>(lineNumber, fields, state);
+}
 
-    //DumpCache(cacheAssociation,refCounter);
-    } //Main Program Loop
+
+
+//Checks one reference and, if it is usable, simulates it.
+//lineNumber is the 1-based trace line, used only for error messages.
+template <class Policy>
+void SimulateReference(size_t lineNumber, const TraceFields & fields, SimulationState & state)
+{
+    //A problem is reported on cerr, which flushes the result lines before it, so the queued references go first
+    if (state.libraryCache != NULL && !TraceFieldsValid(fields))
+        RunLibraryBatch(state);
     
-    PrintSummary(hitCounter,missCounter,refCounter);
-} //end main
+    if (!ValidateTraceFields(lineNumber, fields))
+        return; //continue to next line
+    
+    SimulateValidReference<Policy>(fields, state);
+}
 
 
-/* Function Definitions and Implementations */
 
-//Reads the configuration file and assigns values to program variables.
-//The configuration file is assumed to be valid for this program.
-void ReadConfig()
+//Queues a reference for the plain data cache as one Ref per line it touches, so that every line still gets its
+//own result line, and runs the queue through the cache when it is full
+void QueueLibraryReference(const TraceFields & fields, SimulationState & state)
 {
-    std::ifstream inConfigFile("trace.config",std::ios::in);
-    if (!inConfigFile)
+    const CacheModel & dataCache = state.libraryCache->Model();
+    CacheAddress address = fields.address;
+    unsigned int remaining = fields.dataSize;
+    while (true)
     {
-        std::cerr << "Configuration file could not be opened\n";
+        unsigned int size = BytesInFirstLine(dataCache, address, remaining);
+        Ref ref = {address, size, fields.mode};
+        state.libraryRefs.push_back(ref);
+        if (state.libraryRefs.size() == LIBRARY_BATCH_SIZE)
+            RunLibraryBatch(state);
+        remaining -= size;
+        if (remaining == 0)
+            return;
+        address += size;
+    }
+}
+
+
+
+//Runs the queued line accesses through the plain data cache and prints their result lines
+void RunLibraryBatch(SimulationState & state)
+{
+    Cache & dataCache = *state.libraryCache;
+    const std::vector<Ref> & refs = state.libraryRefs;
+    size_t firstAccess = dataCache.Accesses();
+    if (dataCache.Access(refs.data(), refs.size(), state.libraryResults.data()) != refs.size())
+    {
+        std::cerr << "Invalid reference passed to the cache\n"; //every reference was validated when it was read
         exit(EXIT_FAILURE);
     }
-    inConfigFile.seekg(std::ios::beg);
     
-    //iterate through the line until the ":" is found
-    char searchChar = '\0';
+    if (state.printReferences)
+    {
+        for (size_t i = 0; i < refs.size(); ++i)
+            PrintReference(firstAccess + i + 1, refs[i].mode, refs[i].address, state.libraryResults[i], MISS_NONE);
+    }
+    state.libraryRefs.clear();
+}
+
+
+
+//Runs a reference through a cache with nothing below it, one access per line the reference touches
+void AccessReference(CacheModel & cache, const TraceFields & fields, AccessResult & result)
+{
+    CacheAddress address = fields.address;
+    unsigned int remaining = fields.dataSize;
+    while (true)
+    {
+        unsigned int size = BytesInFirstLine(cache, address, remaining);
+        cache.accessKernel(cache, fields.mode, address, size, result);
+        remaining -= size;
+        if (remaining == 0)
+            return;
+        address += size;
+    }
+}
+
+
+//Simulates one reference that already passed the mode, size and alignment checks against every cache,
+//and prints the result line when there is a single cache.
+template <class Policy>
+void SimulateValidReference(const TraceFields & fields, SimulationState & state)
+{
+    if (state.referenceQueue != NULL) //sweep workers simulate it
+    {
+        QueueReference(fields, state);
+        return;
+    }
+    if (state.stackDistance != NULL)
+    {
+        AccessStackDistance(*state.stackDistance, fields.address, fields.dataSize);
+        return;
+    }
+    if (state.coherence != NULL) //queued, and simulated a batch at a time
+    {
+        QueueCoreAccesses<Policy>(fields, state);
+        return;
+    }
+    if (state.libraryCache != NULL) //likewise
+    {
+        QueueLibraryReference(fields, state);
+        return;
+    }
     
-    while (searchChar != ':')
+    AccessResult result;
+    if (!state.tracksTraffic) //a sweep: every cache sees the reference and nothing goes below them
     {
-        searchChar = inConfigFile.get();
+        for (size_t i = 0; i < state.caches.size(); ++i)
+            AccessReference(state.caches[i], fields, result);
+        return;
     }
-    inConfigFile >> numSets; //read the numSets line
-    searchChar = '\0';
     
-    //continue to the next line until next ':' is found
-    while (searchChar != ':')
+    if (++state.tracePosition <= state.resumePosition) //already simulated by the run that wrote the checkpoint
+        return;
+    
+    //Time sampling passes over the references between its windows, and warms the cache up uncounted before each
+    CacheModel & dataCache = state.caches[0];
+    bool timeSampled = state.sampler != NULL && state.sampler->SamplesTime();
+    SamplePhase phase = SAMPLE_MEASURE;
+    if (timeSampled)
     {
-        searchChar = inConfigFile.get();
+        phase = state.sampler->Phase(state.tracePosition);
+        if (phase == SAMPLE_SKIP)
+            return;
+        if (phase == SAMPLE_MEASURE)
+            state.sampler->MeasureReference(dataCache.refCounter, dataCache.missCounter);
     }
-    inConfigFile >> associativityLevel; //read the numSets line
-    searchChar = '\0';
+    bool setSampled = state.sampler != NULL && state.sampler->SamplesSets();
     
-    //continue to the next line until next ':' is found
-    while (searchChar != ':')
+    //The data cache: a reference that runs past the end of a line is one access, and one result line, per line
+    CacheAddress address = fields.address;
+    unsigned int remaining = fields.dataSize;
+    while (true)
     {
-        searchChar = inConfigFile.get();
+        unsigned int size = BytesInFirstLine(dataCache, address, remaining);
+        if (setSampled && !state.sampler->SetSampled(static_cast<unsigned int>(address >> dataCache.offsetShamt) & dataCache.indexBitMask))
+            state.sampler->SkipAccess(); //a set outside the sample, dropped before any tag work
+        else
+        {
+            if (state.prefetcher.Enabled())
+                InstallPrefetches(state);
+            dataCache.accessKernel(dataCache, fields.mode, address, size, result);
+            MissClass missClass = MISS_NONE; //set only when misses are classified
+            if (state.missClassifier != NULL)
+            {
+                bool allocates = writeAllocate || fields.mode == 'R' || fields.mode == 'r'; //the shadow cache allocates as the data cache does
+                missClass = state.missClassifier->Classify(address >> dataCache.offsetShamt, result.isThere, allocates);
+            }
+            if (state.setStatistics != NULL)
+                state.setStatistics->RecordAccess(result.index, result.isThere, result.evicted, result.evictedDirty);
+            if (setSampled)
+                state.sampler->RecordSetAccess(result.index, result.isThere);
+            HandleDataCacheTraffic(state, address, result); //fetches and writes go on to main memory or the levels below
+            if (state.prefetcher.Enabled())
+                HandlePrefetch(state, address, result);
+            
+            if (state.printReferences)
+            {
+                RefResult row = {result.tag, result.index, result.offset, result.memrefs, result.isThere};
+                PrintReference(dataCache.refCounter, fields.mode, address, row, missClass);
+                //DumpCache(dataCache.cacheAssociation,dataCache.refCounter);
+            }
+        }
+        
+        remaining -= size;
+        if (remaining == 0)
+            break;
+        address += size;
     }
-    inConfigFile >> lineSize; //read the numSets line
-    searchChar = '\0';
     
-    //Finished with configuration file
-    inConfigFile.close();
+    if (timeSampled && phase == SAMPLE_MEASURE)
+        state.sampler->EndReference(state.tracePosition, dataCache.refCounter, dataCache.missCounter);
+    if (state.tracePosition == state.nextCheckpoint)
+    {
+        SaveCheckpoint(state, saveStateFileName);
+        state.nextCheckpoint += saveStateInterval;
+    }
 }
 
 
 
-//Prints the configuration information to the
-void PrintConfig()
+//Records the stack depth of one reference, once for every line it touches as in the cache model
+void AccessStackDistance(StackDistanceModel & model, const CacheAddress address, const unsigned int dataSize)
 {
-    std::cout << "Cache Configuration\n\n";
-    std::cout << "   " << numSets << " " << associativityLevel << "-way set associative entries\n";
-    std::cout << "   of line size " << lineSize << " bytes\n\n\n";
+    CacheAddress lastLine = (address + dataSize - 1) >> model.offsetShamt;
+    for (CacheAddress line = address >> model.offsetShamt; ; ++line)
+    {
+        ++model.refCounter;
+        unsigned int index = static_cast<unsigned int>(line & model.indexBitMask);
+        CacheTag tag = line >> model.indexShamt;
+        
+        size_t depth = model.sets[index].Access(tag);
+        if (depth != 0 && depth < model.depthCounter.size())
+            ++model.depthCounter[depth];
+        
+        if (line == lastLine)
+            break;
+    }
 }
 
 
 
-//Prints the summary statistics
-void PrintSummary(size_t hitCounter, size_t missCounter, size_t refCounter)
+//Sets up a stack distance run with empty stacks and the address split of the geometry
+void InitStackDistanceModel(StackDistanceModel & model, const CacheGeometry & geometry)
 {
-    std::cout << "\n\nSimulation Summary Statistics\n";
-    std::cout << "-----------------------------\n";
-    std::cout << "Total hits       : " << hitCounter << "\n";
-    std::cout << "Total misses     : " << missCounter << "\n";
-    std::cout << "Total accesses   : " << refCounter << "\n";
-    float hitRatio = static_cast<float>(hitCounter) / refCounter;
-    float missRatio = static_cast<float>(missCounter) / refCounter;
-    std::cout << "Hit ratio        : " << std::fixed << std::setprecision(6) << hitRatio << "\n";
-    std::cout << "Miss ratio       : " << std::fixed << std::setprecision(6) << missRatio << "\n\n";
+    model.geometry = geometry;
+    model.offsetShamt = static_cast<unsigned int>(log2(geometry.lineSize));
+    model.indexBitMask = static_cast<unsigned int>(geometry.numSets - 1);
+    model.indexShamt = static_cast<unsigned int>(log2(geometry.numSets));
+    model.sets.assign(geometry.numSets, StackDistanceSet());
+    model.depthCounter.assign(geometry.associativityLevel + 1, 0);
+    model.refCounter = 0;
 }
 
 
 
-//Reads trace.dat file and stores it in a vector for later use
-size_t ReadDataTrace(std::vector<std::string> & traceDat)
+//Carries one reference's traffic from the data cache to the level below it, main memory or the next level of a
+//hierarchy: the line a miss fetched, the line it replaced and a store written through or around the cache.
+//With a write buffer the writes wait in it, and memrefs is recounted as the fetch plus the lines the buffer drained.
+void HandleDataCacheTraffic(SimulationState & state, const CacheAddress address, AccessResult & result)
 {
-    //NOTE - This program was developed and tested using XCode which does not directly support re-directed input
-    //Therefore the unneccesary commands will be commented out when compiling for UNIX command line.
-    std::streambuf *cinBuf, *datBuf;
-    cinBuf = std::cin.rdbuf(); //backs up the std::cin buffer.
+    if (state.writeBuffer.Entries() > 0)
+        result.memrefs = result.fetched ? 1 : 0;
+    
+    if (result.fetched)
+        ReadBelow(state, address, result.fetchedSectors);
     
-    /*
-    //*************comment out this section to prepare for cin read
-    std::ifstream inDatFile("testBig4.dat",std::ios::in);
-    if (!inDatFile)
+    if (result.evicted)
     {
-        std::cerr << "Failed to read data file.\n";
-        exit(EXIT_FAILURE);
+        if (result.evictedDirty)
+            WriteBelow(state, result.evictedAddress, result.evictedSectors, result);
+        else if (!state.lowerLevels.empty())
+            PassDown(state, 0, result.evictedAddress, false); //only exclusive levels take clean lines
     }
-    datBuf = inDatFile.rdbuf(); //obtains buffer for inFile stream
-    std::cin.rdbuf(datBuf);   //Assign cin to the data buffer.  Now, cin will be reading from file.
-    //*************comment out this section to prepare for cin read
-    */
-    
-    std::string inputLine;
-    numDataLines = 0;
     
-    //continue reading until end found
-    while (std::getline(std::cin, inputLine))
+    if (result.storeThrough)
+        WriteBelow(state, address & ~static_cast<CacheAddress>(state.caches[0].offsetBitMask), result.storeSectors, result);
+}
+
+
+
+//Reads a line, or the given sectors of it, into the data cache from the level below
+void ReadBelow(SimulationState & state, const CacheAddress address, unsigned int sectors)
+{
+    CacheModel & dataCache = state.caches[0];
+    if (state.lowerLevels.empty())
     {
-        traceDat.push_back(inputLine); //adds the line to the data vector
-        ++numDataLines;
-        
+        ++state.memoryReads;
+        state.memoryReadBytes += TransferBytes(dataCache, sectors);
+        return;
     }
     
-    std::cin.rdbuf(cinBuf); //restore cin to original state; has no effect if previous section is commented out
-    return numDataLines;
+    LineResult lineResult;
+    bool lineDirty = false;
+    FetchFromLevel(state, 0, address, lineDirty);
+    if (lineDirty) //an exclusive level gave up a dirty line, the data cache holds the only copy now
+        dataCache.lineKernel(dataCache, LINE_SET_DIRTY, address, false, lineResult);
 }
 
-//checks to see if there is a problem with the input based on configuration properties.
 
-void ModeValidityCheck(const char mode)
+
+//Writes the given sectors of a line of the data cache to the level below, through the write buffer if there is one
+void WriteBelow(SimulationState & state, const CacheAddress lineAddress, unsigned int sectors, AccessResult & result)
 {
-    if (mode != 'R' && mode != 'W' && mode != 'r' && mode != 'w')
+    if (state.writeBuffer.Entries() == 0)
     {
-        std::cerr << "Mode is invalid.  Exiting.\n";
-        exit(EXIT_FAILURE);
+        WriteLineBelow(state, lineAddress, sectors);
+        return;
+    }
+    
+    CacheAddress drainedLine;
+    unsigned int drainedSectors;
+    if (state.writeBuffer.Add(lineAddress, sectors, drainedLine, drainedSectors))
+    {
+        WriteLineBelow(state, drainedLine, drainedSectors);
+        ++result.memrefs;
     }
 }
 
-//returns TRUE if there is an error with the data size
-bool SizeCheck(const unsigned int size)
+
+
+//Writes the given sectors of a line of the data cache to main memory, or the whole line to the next level
+void WriteLineBelow(SimulationState & state, const CacheAddress lineAddress, unsigned int sectors)
 {
-    bool sizeError = 0; //set default to no problem
-    if (size != 1 && size != 2 && size != 4 && size != 8)
+    if (state.lowerLevels.empty())
     {
-        sizeError = 1;
+        ++state.memoryWrites;
+        state.memoryWriteBytes += TransferBytes(state.caches[0], sectors);
     }
-    return sizeError;
+    else
+        PassDown(state, 0, lineAddress, true);
 }
 
-//returns TRUE if there is an error with the alignment
-bool AlignmentCheck(const unsigned int size, const unsigned int address)
+
+
+//Writes every line still in the write buffer to the level below
+void FlushWriteBuffer(SimulationState & state)
 {
-    //if size is not multiple of the address then error
-    if ((address % size) != 0)
-        return 1;
-    else
-        return 0;
+    CacheAddress drainedLine;
+    unsigned int drainedSectors;
+    while (state.writeBuffer.Drain(drainedLine, drainedSectors))
+        WriteLineBelow(state, drainedLine, drainedSectors);
+}
+
+
+
+//Checks a demand access of the data cache against the prefetches, then trains the prefetcher on it and issues the
+//lines it predicts.  The prefetcher learns from misses and from the first use of each line it brought in.
+void HandlePrefetch(SimulationState & state, const CacheAddress address, const AccessResult & result)
+{
+    CacheModel & dataCache = state.caches[0];
+    LineResult lineResult;
+    dataCache.lineKernel(dataCache, LINE_CLAIM, address, false, lineResult); //after a miss the mark was the replaced line's
+    
+    if (result.isThere)
+    {
+        if (!lineResult.prefetched)
+            return;
+        ++state.prefetchUseful;
+    }
+    else
+    {
+        //a miss on a line that is still on its way: the prefetch was right but too late, and the miss fetched it
+        CacheAddress lineAddress = address & ~static_cast<CacheAddress>(dataCache.offsetBitMask);
+        for (std::deque<PendingPrefetch>::iterator prefetch = state.pendingPrefetches.begin();
+             prefetch != state.pendingPrefetches.end(); ++prefetch)
+        {
+            if (prefetch->address == lineAddress)
+            {
+                ++state.prefetchLate;
+                state.pendingPrefetches.erase(prefetch);
+                break;
+            }
+        }
+    }
+    
+    state.predictions.clear();
+    state.prefetcher.Train(address >> dataCache.offsetShamt, state.predictions);
+    for (size_t i = 0; i < state.predictions.size(); ++i)
+        IssuePrefetch(state, state.predictions[i] << dataCache.offsetShamt);
+}
+
+
+
+//Prefetches the line at address unless the data cache holds it or it is already on its way.  The line is read
+//from the level below now and filled into the data cache prefetchLatency references later.
+void IssuePrefetch(SimulationState & state, const CacheAddress address)
+{
+    CacheModel & dataCache = state.caches[0];
+    LineResult lineResult;
+    dataCache.lineKernel(dataCache, LINE_PROBE, address, false, lineResult);
+    if (lineResult.hit)
+        return;
+    for (size_t i = 0; i < state.pendingPrefetches.size(); ++i)
+    {
+        if (state.pendingPrefetches[i].address == address)
+            return;
+    }
+    
+    ++state.prefetchIssued;
+    ReadBelow(state, address, 1);
+    PendingPrefetch prefetch = {address, dataCache.refCounter + prefetchLatency};
+    state.pendingPrefetches.push_back(prefetch);
+}
+
+
+
+//Fills the prefetched lines that have arrived into the data cache, through its own sets and replacement policy.
+//A line a demand miss brought in meanwhile is left alone.
+void InstallPrefetches(SimulationState & state)
+{
+    CacheModel & dataCache = state.caches[0];
+    while (!state.pendingPrefetches.empty() && state.pendingPrefetches.front().readyAt <= dataCache.refCounter)
+    {
+        CacheAddress address = state.pendingPrefetches.front().address;
+        state.pendingPrefetches.pop_front();
+        
+        LineResult lineResult;
+        dataCache.lineKernel(dataCache, LINE_PREFETCH, address, false, lineResult);
+        if (!lineResult.evicted)
+            continue;
+        if (state.setStatistics != NULL)
+            state.setStatistics->RecordEviction((lineResult.evictedAddress >> dataCache.offsetShamt) & dataCache.indexBitMask,
+                                                lineResult.evictedDirty);
+        if (lineResult.evictedDirty)
+        {
+            AccessResult prefetchResult; //buffer drains caused by a prefetch are not charged to a reference
+            prefetchResult.memrefs = 0;
+            ++dataCache.writebackCounter;
+            WriteBelow(state, lineResult.evictedAddress, 1, prefetchResult);
+        }
+        else if (!state.lowerLevels.empty())
+            PassDown(state, 0, lineResult.evictedAddress, false);
+    }
+}
+
+
+
+//Looks up a line missing from the level above lowerLevels[level] and brings it up from there or further down.
+//lineDirty is set if the line comes out of an exclusive level dirty.
+void FetchFromLevel(SimulationState & state, size_t level, const CacheAddress address, bool & lineDirty)
+{
+    if (level == state.lowerLevels.size())
+    {
+        ++state.memoryReads;
+        state.memoryReadBytes += state.lowerLevels.back().geometry.lineSize;
+        return;
+    }
+    
+    CacheModel & cache = state.lowerLevels[level];
+    LineResult lineResult;
+    ++cache.refCounter;
+    
+    //An exclusive level gives its copy up; otherwise the line is read and allocated here on a miss
+    cache.lineKernel(cache, (inclusionPolicy == INCLUSION_EXCLUSIVE) ? LINE_INVALIDATE : LINE_READ, address, false, lineResult);
+    if (lineResult.hit)
+    {
+        ++cache.hitCounter;
+        lineDirty = lineResult.dirty && inclusionPolicy == INCLUSION_EXCLUSIVE;
+        return;
+    }
+    
+    ++cache.missCounter;
+    if (lineResult.evicted)
+        EvictFromLevel(state, level, lineResult.evictedAddress, lineResult.evictedDirty);
+    FetchFromLevel(state, level + 1, address, lineDirty);
+}
+
+
+
+//Hands a line that left the level above lowerLevels[level] to that level: every line when levels are exclusive,
+//only dirty ones (as a write back) otherwise.  Past the last level a dirty line goes to main memory.
+void PassDown(SimulationState & state, size_t level, const CacheAddress address, bool dirty)
+{
+    if (level == state.lowerLevels.size())
+    {
+        if (dirty)
+        {
+            ++state.memoryWrites;
+            state.memoryWriteBytes += state.lowerLevels.back().geometry.lineSize;
+        }
+        return;
+    }
+    if (!dirty && inclusionPolicy != INCLUSION_EXCLUSIVE)
+        return;
+    
+    CacheModel & cache = state.lowerLevels[level];
+    LineResult lineResult;
+    cache.lineKernel(cache, LINE_INSERT, address, dirty, lineResult);
+    if (lineResult.evicted)
+        EvictFromLevel(state, level, lineResult.evictedAddress, lineResult.evictedDirty);
+}
+
+
+
+//A line was replaced in lowerLevels[level].  An inclusive hierarchy first removes it from every level above,
+//picking up their dirty data; the line then continues down.
+void EvictFromLevel(SimulationState & state, size_t level, const CacheAddress address, bool dirty)
+{
+    if (inclusionPolicy == INCLUSION_INCLUSIVE && BackInvalidate(state, level, address))
+        dirty = true;
+    if (dirty)
+        ++state.lowerLevels[level].writebackCounter;
+    PassDown(state, level + 1, address, dirty);
+}
+
+
+
+//Removes the line of lowerLevels[level] at address from the data cache and every level between.  An upper line
+//can be smaller, so every upper line inside it is removed.  Returns TRUE if any removed copy was dirty.
+bool BackInvalidate(SimulationState & state, size_t level, const CacheAddress address)
+{
+    size_t evictedLineSize = state.lowerLevels[level].geometry.lineSize;
+    bool dirty = false;
+    for (size_t upper = 0; upper <= level; ++upper)
+    {
+        CacheModel & cache = (upper == 0) ? state.caches[0] : state.lowerLevels[upper - 1];
+        for (size_t offset = 0; offset < evictedLineSize; offset += cache.geometry.lineSize)
+        {
+            LineResult lineResult;
+            cache.lineKernel(cache, LINE_INVALIDATE, address + offset, false, lineResult);
+            if (lineResult.hit)
+            {
+                ++cache.invalidationCounter;
+                dirty = dirty || lineResult.dirty;
+            }
+        }
+    }
+    return dirty;
+}
+
+
+
+//Starts the sweep worker threads.  There are at most workerThreads of them and never more than caches; cache i
+//belongs to worker i % workers.
+template <class Policy>
+void StartSweepWorkers(SimulationState & state, std::vector<std::thread> & workers)
+{
+    size_t workerCount = std::min(workerThreads, state.caches.size());
+    state.referenceQueue = new ReferenceBroadcastQueue(workerCount);
+    for (size_t worker = 0; worker < workerCount; ++worker)
+        workers.push_back(std::thread(SweepWorker<Policy>, std::ref(state), worker, workerCount));
+}
+
+
+
+//Body of one sweep worker.  Each batch is run through one cache at a time, so a cache's storage stays hot in
+//this core's caches for the whole batch.  Only this worker touches its caches.
+template <class Policy>
+void SweepWorker(SimulationState & state, size_t worker, size_t workerCount)
+{
+    AccessResult result;
+    const ReferenceBatch *batch;
+    while ((batch = state.referenceQueue->Acquire(worker)) != NULL)
+    {
+        for (size_t i = worker; i < state.caches.size(); i += workerCount)
+        {
+            CacheModel & cache = state.caches[i];
+            for (size_t ref = 0; ref < batch->count; ++ref)
+                AccessReference(cache, batch->refs[ref], result);
+        }
+        state.referenceQueue->Release(worker);
+    }
+}
+
+
+
+//Adds a validated reference to the batch being filled and publishes the batch once it is full
+void QueueReference(const TraceFields & fields, SimulationState & state)
+{
+    if (state.pendingBatch == NULL)
+        state.pendingBatch = &state.referenceQueue->ProducerSlot();
+    
+    ReferenceBatch & batch = *state.pendingBatch;
+    batch.refs[batch.count++] = fields;
+    if (batch.count == REFERENCE_BATCH_SIZE)
+    {
+        state.referenceQueue->Publish();
+        state.pendingBatch = NULL;
+    }
+}
+
+
+
+//Publishes the last partial batch, waits for the workers to drain the queue and releases it
+void FinishSweepWorkers(SimulationState & state, std::vector<std::thread> & workers)
+{
+    if (state.pendingBatch != NULL)
+    {
+        state.referenceQueue->Publish();
+        state.pendingBatch = NULL;
+    }
+    state.referenceQueue->Close();
+    for (size_t worker = 0; worker < workers.size(); ++worker)
+        workers[worker].join();
+    
+    delete state.referenceQueue;
+    state.referenceQueue = NULL;
+    workers.clear();
+}
+
+
+
+//Splits a reference of a multi-core trace into one access per line it touches, marks each access private or shared
+//from the first-touch owner of its line, and simulates the queued accesses once a batch is full
+template <class Policy>
+void QueueCoreAccesses(const TraceFields & fields, SimulationState & state)
+{
+    CoherenceModel & model = *state.coherence;
+    ++state.tracePosition;
+    if (fields.core >= model.cores.size())
+    {
+        std::cerr << "Reference " << state.tracePosition << " is made by core " << fields.core << ", but trace.config has " <<
+            model.cores.size() << " cores\n";
+        exit(EXIT_FAILURE);
+    }
+    
+    const CacheModel & geometry = model.cores[0].cache; //every core's cache has the same address split
+    CacheAddress address = fields.address;
+    unsigned int remaining = fields.dataSize;
+    while (true)
+    {
+        unsigned int size = BytesInFirstLine(geometry, address, remaining);
+        CoreAccess access;
+        access.address = address;
+        access.core = static_cast<unsigned short>(fields.core);
+        access.dataSize = static_cast<unsigned char>(size);
+        access.mode = fields.mode;
+        access.shared = !model.owners.Touch(address >> geometry.offsetShamt, fields.core);
+        model.pending.push_back(access);
+        
+        remaining -= size;
+        if (remaining == 0)
+            break;
+        address += size;
+    }
+    
+    if (model.pending.size() >= CORE_BATCH_SIZE)
+        RunCoreAccesses<Policy>(model);
+}
+
+
+
+//Simulates the queued line accesses in trace order.  A run of private accesses between two shared ones only
+//touches the caches of the cores that made them, so it can be simulated core by core; every shared access is
+//simulated on its own once the run before it is done.
+template <class Policy>
+void RunCoreAccesses(CoherenceModel & model)
+{
+    const CoreAccess *accesses = model.pending.data();
+    size_t runStart = 0;
+    for (size_t i = 0; i < model.pending.size(); ++i)
+    {
+        if (!accesses[i].shared)
+            continue;
+        RunPrivateAccesses<Policy>(model, accesses + runStart, i - runStart);
+        AccessCoherent<Policy>(model, accesses[i]);
+        ++model.sharedAccesses;
+        runStart = i + 1;
+    }
+    RunPrivateAccesses<Policy>(model, accesses + runStart, model.pending.size() - runStart);
+    model.pending.clear();
+}
+
+
+
+//Simulates a run of private accesses, shared out between the core workers when there are any and the run is long
+//enough to be worth waking them
+template <class Policy>
+void RunPrivateAccesses(CoherenceModel & model, const CoreAccess *run, size_t count)
+{
+    model.privateAccesses += count;
+    if (model.dispatcher == NULL || count < PARALLEL_RUN_MIN)
+    {
+        for (size_t i = 0; i < count; ++i)
+            AccessCoherent<Policy>(model, run[i]);
+        return;
+    }
+    
+    model.dispatcher->Start(run, count);
+    AccessCoreShare<Policy>(model, run, count, 0, model.workers.size() + 1); //the reader is worker 0
+    model.dispatcher->Wait();
+    ++model.parallelRuns;
+}
+
+
+
+//Simulates the accesses of a run made by the cores of one worker; core c belongs to worker c % workers
+template <class Policy>
+void AccessCoreShare(CoherenceModel & model, const CoreAccess *run, size_t count, size_t worker, size_t workers)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (run[i].core % workers == worker)
+            AccessCoherent<Policy>(model, run[i]);
+    }
+}
+
+
+
+//Simulates one line access of a core against its private data cache.
+//A read hit, or a write hit on an E or M line, stays inside the core.  A write hit on an S or O line upgrades it
+//to M, invalidating every other copy.  A miss reads the line over the bus: a write miss invalidates every other
+//copy, a read miss leaves them shared, and a dirty copy supplies the data instead of memory.  Private accesses
+//cannot find the line in another cache, so they skip the snoop and the sharing statistics altogether.
+template <class Policy>
+void AccessCoherent(CoherenceModel & model, const CoreAccess & access)
+{
+    CoherentCore & core = model.cores[access.core];
+    CacheModel & cache = core.cache;
+    CacheStorageView<0> cacheAssociation(cache.cacheAssociation);
+    CoreCounters & counters = core.counters;
+    CacheAddress line = access.address >> cache.offsetShamt;
+    unsigned int index = static_cast<unsigned int>(line & cache.indexBitMask);
+    CacheTag tag = line >> cache.indexShamt;
+    bool write = (access.mode == 'W' || access.mode == 'w');
+    uint64_t chunks = 0; //chunks of the line the access touches, tracked for shared lines only
+    if (access.shared)
+    {
+        chunks = model.sharing.ChunkMask(access.address, access.dataSize);
+        model.sharing.Touch(access.core, line);
+    }
+    
+    ++cache.refCounter;
+    unsigned int matchMask = RunTagMatch(cache.options.tagMatch, cacheAssociation.SetTags(index), cacheAssociation.ValidMask(index), tag,
+                                         cacheAssociation.Ways());
+    
+    //HIT**********
+    if (matchMask != 0)
+    {
+        size_t way = 31 - __builtin_clz(matchMask);
+        ++cache.hitCounter;
+        Policy::OnHit(cacheAssociation, index, way);
+        if (!write)
+            return;
+        if (IsShared(core, index, way)) //S or O: the other copies go before the line becomes M
+        {
+            ++counters.busUpgrades;
+            for (size_t other = 0; other < model.cores.size(); ++other)
+            {
+                if (other != access.core)
+                    SnoopCore<Policy>(model, other, access.address, true);
+            }
+            SetShared(core, index, way, false);
+        }
+        cacheAssociation.SetDirty(index, way, true); //E and M are now M
+        if (access.shared)
+            model.sharing.Written(access.core, line, chunks);
+        return;
+    }
+    
+    //MISS**********
+    ++cache.missCounter;
+    bool falseSharing = false;
+    if (access.shared && model.sharing.Miss(access.core, line, chunks, falseSharing))
+    {
+        ++counters.coherenceMisses;
+        counters.falseSharingMisses += falseSharing;
+    }
+    
+    bool otherCopies = false;
+    bool dirtySupplied = false;
+    if (access.shared)
+    {
+        for (size_t other = 0; other < model.cores.size(); ++other)
+        {
+            if (other == access.core)
+                continue;
+            CoherenceState found = SnoopCore<Policy>(model, other, access.address, write);
+            otherCopies = otherCopies || found != COHERENCE_INVALID;
+            dirtySupplied = dirtySupplied || found == COHERENCE_MODIFIED || found == COHERENCE_OWNED;
+        }
+        if (write)
+            model.sharing.Written(access.core, line, chunks);
+    }
+    if (write)
+        ++counters.busReadExclusives;
+    else
+        ++counters.busReads;
+    if (dirtySupplied)
+        ++counters.cacheToCache;
+    else
+        ++counters.memoryReads;
+    
+    //replace the policy's victim; an M or O victim is written back
+    size_t way = Policy::Victim(cacheAssociation, index);
+    if (((cacheAssociation.ValidMask(index) >> way) & 1) && cacheAssociation.IsDirty(index, way))
+    {
+        ++cache.writebackCounter;
+        ++counters.memoryWrites;
+    }
+    cacheAssociation.SetDirty(index, way, write);
+    SetShared(core, index, way, !write && otherCopies);
+    cacheAssociation.SetValid(index, way);
+    cacheAssociation.SetTag(index, way, tag);
+    Policy::OnFill(cacheAssociation, index, way);
+}
+
+
+
+//Applies another core's bus request for the line at address to this core's copy, and returns the state the copy
+//was in.  A request for ownership invalidates the copy.  A read leaves it shared: in MESI a modified copy is
+//written back first, in MOESI it stays dirty as the owner.
+template <class Policy>
+CoherenceState SnoopCore(CoherenceModel & model, size_t coreNumber, CacheAddress address, bool exclusive)
+{
+    CoherentCore & core = model.cores[coreNumber];
+    CacheModel & cache = core.cache;
+    CacheStorageView<0> cacheAssociation(cache.cacheAssociation);
+    CacheAddress line = address >> cache.offsetShamt;
+    unsigned int index = static_cast<unsigned int>(line & cache.indexBitMask);
+    CacheTag tag = line >> cache.indexShamt;
+    
+    unsigned int matchMask = RunTagMatch(cache.options.tagMatch, cacheAssociation.SetTags(index), cacheAssociation.ValidMask(index), tag,
+                                         cacheAssociation.Ways());
+    if (matchMask == 0)
+        return COHERENCE_INVALID;
+    
+    size_t way = 31 - __builtin_clz(matchMask);
+    bool dirty = cacheAssociation.IsDirty(index, way);
+    bool shared = IsShared(core, index, way);
+    CoherenceState found = dirty ? (shared ? COHERENCE_OWNED : COHERENCE_MODIFIED) :
+                                   (shared ? COHERENCE_SHARED : COHERENCE_EXCLUSIVE);
+    if (exclusive)
+    {
+        cacheAssociation.ClearValid(index, way);
+        cacheAssociation.SetDirty(index, way, false); //a dirty copy went to the requester, which now owns the data
+        SetShared(core, index, way, false);
+        Policy::OnInvalidate(cacheAssociation, index, way);
+        ++cache.invalidationCounter;
+        model.sharing.Invalidated(static_cast<unsigned int>(coreNumber), line);
+    }
+    else
+    {
+        if (found == COHERENCE_MODIFIED && coherenceProtocol == PROTOCOL_MESI)
+        {
+            cacheAssociation.SetDirty(index, way, false);
+            ++cache.writebackCounter;
+            ++core.counters.memoryWrites;
+        }
+        SetShared(core, index, way, true);
+    }
+    return found;
+}
+
+
+
+//returns TRUE if the line in way of set index is held in S or O
+bool IsShared(const CoherentCore & core, unsigned int index, size_t way)
+{
+    return (core.sharedBits[index] >> way) & 1;
+}
+
+void SetShared(CoherentCore & core, unsigned int index, size_t way, bool shared)
+{
+    if (shared)
+        core.sharedBits[index] |= static_cast<unsigned char>(1 << way);
+    else
+        core.sharedBits[index] &= static_cast<unsigned char>(~(1 << way));
+}
+
+
+
+//Starts the core worker threads.  There are at most workerThreads workers, counting the trace reader, and never
+//more than cores.
+template <class Policy>
+void StartCoreWorkers(CoherenceModel & model)
+{
+    size_t workerCount = std::min(workerThreads, model.cores.size());
+    if (workerCount < 2)
+        return;
+    model.dispatcher = new CoreRunDispatcher(workerCount);
+    for (size_t worker = 1; worker < workerCount; ++worker)
+        model.workers.push_back(std::thread(CoreWorker<Policy>, std::ref(model), worker, workerCount));
+}
+
+
+
+//Body of one core worker: simulates its cores' share of every run of private accesses
+template <class Policy>
+void CoreWorker(CoherenceModel & model, size_t worker, size_t workerCount)
+{
+    const CoreAccess *run;
+    size_t count;
+    while (model.dispatcher->Next(worker, run, count))
+    {
+        AccessCoreShare<Policy>(model, run, count, worker, workerCount);
+        model.dispatcher->Done(worker);
+    }
+}
+
+
+
+//Stops the core workers once every run is done
+void FinishCoreWorkers(CoherenceModel & model)
+{
+    if (model.dispatcher == NULL)
+        return;
+    model.dispatcher->Close();
+    for (size_t worker = 0; worker < model.workers.size(); ++worker)
+        model.workers[worker].join();
+    
+    delete model.dispatcher;
+    model.dispatcher = NULL;
+    model.workers.clear();
+}
+
+
+
+//Prints the result line of one reference.
+//The fields go straight into the output buffer, right aligned in the same widths the setw() version used.
+void PrintReference(size_t refCounter, const char mode, const CacheAddress address, const RefResult & result, MissClass missClass)
+{
+    //output results
+    referenceOutput.PutDecimal(refCounter, 4);
+    if (mode == 'R' || mode == 'r')
+        referenceOutput.PutText("read", 7);
+    if (mode == 'W' || mode == 'w')
+        referenceOutput.PutText("write", 7);
+    referenceOutput.PutHex(address, 9);
+    referenceOutput.PutHex(result.tag, 8);
+    referenceOutput.PutDecimal(result.index, 6);
+    referenceOutput.PutDecimal(result.offset, 7);
+    if (result.hit) //if it was a hit
+        referenceOutput.PutText("hit", 7);
+    else
+        referenceOutput.PutText("miss", 7);
+    referenceOutput.PutDecimal(result.memrefs, 8);
+    if (classifyMisses && !result.hit)
+        referenceOutput.PutText(MissClassName(missClass), 12);
+    referenceOutput.PutChar('\n'); //newline
+}
+
+
+
+//Returns the store handling and set probe trace.config and the command line chose, for every cache of the run
+CacheOptions ConfiguredCacheOptions()
+{
+    CacheOptions options = {writeThrough, writeAllocate, tagMatch, verifyTagMatch};
+    return options;
+}
+
+
+
+//Reads a text trace in TRACE_CHUNK_SIZE blocks and simulates every complete line in place, so memory stays
+//bounded by the chunk size regardless of trace length.  A partial line at the end of a chunk is moved
+//to the front of the buffer and completed by the next read.
+template <class Policy>
+void StreamDataTrace(FILE *traceInput, SimulationState & state)
+{
+    std::vector<char> chunk(TRACE_CHUNK_SIZE);
+    TraceFields fields = {'\0', 0, 0, 0};
+    size_t carried = 0; //bytes of an incomplete line kept from the previous chunk
+    size_t lineNumber = 0;
+    
+    while (true)
+    {
+        if (carried == chunk.size()) //a single line fills the whole buffer, make room for the rest of it
+            chunk.resize(chunk.size() * 2);
+        
+        char *buffer = &chunk[0];
+        size_t bytesRead = fread(buffer + carried, 1, chunk.size() - carried, traceInput);
+        char *bufferEnd = buffer + carried + bytesRead;
+        
+        if (bytesRead == 0) //end of input, simulate a final line that has no newline
+        {
+            if (carried > 0)
+                ProcessTraceLine<Policy>(buffer, bufferEnd, ++lineNumber, fields, state);
+            break;
+        }
+        
+        char *lineStart = buffer;
+        char *newline;
+        while ((newline = static_cast<char *>(memchr(lineStart, '\n', bufferEnd - lineStart))) != NULL)
+        {
+            ProcessTraceLine<Policy>(lineStart, newline, ++lineNumber, fields, state);
+            lineStart = newline + 1;
+        }
+        
+        carried = bufferEnd - lineStart;
+        memmove(buffer, lineStart, carried);
+    }
+    numDataLines = lineNumber;
+}
+
+
+
+//Maps a binary trace written by traceconvert and feeds its records directly to the cache model.
+//A record that fails the checks, from a damaged or hand-made file, is reported by its 1-based record number.
+template <class Policy>
+void SimulateBinaryTrace(const char *fileName, SimulationState & state)
+{
+    MappedTrace trace;
+    MapBinaryTrace(fileName, trace);
+    
+    TraceFields fields;
+    for (uint64_t record = 0; record < trace.recordCount; ++record)
+    {
+        fields.mode = static_cast<char>(trace.records[record].mode);
+        fields.dataSize = trace.records[record].dataSize;
+        fields.address = trace.records[record].address;
+        fields.core = trace.records[record].core;
+        if (!TraceFieldsValid(fields))
+        {
+            if (state.libraryCache != NULL)
+                RunLibraryBatch(state); //the queued references go out before the report, as in SimulateReference()
+            ValidateTraceFields(static_cast<size_t>(record + 1), fields, "record");
+            continue;
+        }
+        SimulateValidReference<Policy>(fields, state);
+    }
+    numDataLines = static_cast<size_t>(trace.recordCount);
+    
+    UnmapBinaryTrace(trace);
+}
+
+
+//Reads the command line options.  Unknown options print the usage and exit.
+void ParseOptions(int argc, char *argv[])
+{
+    const char *probeName = "auto";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        if (option == "--buffered")
+            bufferedInput = true;
+        else if (option == "--trace" && i + 1 < argc)
+            traceFileName = argv[++i];
+        else if (option == "--probe" && i + 1 < argc && SelectTagMatchKernel(argv[i + 1]) != NULL)
+            probeName = argv[++i];
+        else if (option == "--verify-probe")
+            verifyTagMatch = true;
+        else if (option == "--sweep" && i + 1 < argc && ParseSweepSpec(argv[i + 1], sweepGeometries))
+            ++i;
+        else if (option == "--threads" && i + 1 < argc && ParseThreadCount(argv[i + 1], workerThreads))
+            ++i;
+        else if (option == "--summary-only")
+            summaryOnly = true;
+        else if (option == "--generic-kernel")
+            genericKernel = true;
+        else if (option == "--stack-distance" && i + 1 < argc && (stackDistanceWays = strtoul(argv[i + 1], NULL, 10)) > 0)
+            ++i;
+        else if (option == "--classify-misses")
+            classifyMisses = true;
+        else if (option == "--set-stats" && i + 1 < argc)
+            setStatsFileName = argv[++i];
+        else if (option == "--interval" && i + 1 < argc && (intervalLength = strtoul(argv[i + 1], NULL, 10)) > 0)
+            ++i;
+        else if (option == "--interval-stats" && i + 1 < argc)
+            intervalStatsFileName = argv[++i];
+        else if (option == "--save-state" && i + 1 < argc)
+            saveStateFileName = argv[++i];
+        else if (option == "--save-every" && i + 1 < argc && (saveStateInterval = strtoul(argv[i + 1], NULL, 10)) > 0)
+            ++i;
+        else if (option == "--sample-sets" && i + 1 < argc && (setSampleRatio = strtoul(argv[i + 1], NULL, 10)) > 0)
+            ++i;
+        else if (option == "--sample-time" && i + 1 < argc && ParseTimeSampleSpec(argv[i + 1]))
+            ++i;
+        else if (option == "--sharing-stats" && i + 1 < argc)
+            sharingStatsFileName = argv[++i];
+        else if ((option == "--load-state" || option == "--warm-state") && i + 1 < argc)
+        {
+            loadStateFileName = argv[++i];
+            warmStart = (option == "--warm-state");
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--buffered] [--trace file] [--probe kernel] [--verify-probe] [--sweep list] [--threads n] [--stack-distance n] [--summary-only] [--generic-kernel] [--classify-misses] [--set-stats file] [--interval n --interval-stats file]\n"
+                      "   [--save-state file [--save-every n]] [--load-state file | --warm-state file]\n"
+                      "   [--sample-sets k | --sample-time w:p[:u]] [--sharing-stats file] < trace.dat\n";
+            std::cerr << "   --buffered          read the whole trace before simulating (default streams stdin)\n";
+            std::cerr << "   --trace file        read a text trace, or a binary trace made by traceconvert, from file\n";
+            std::cerr << "   --probe kernel      tag match kernel: auto (default), avx2, sse4.1, sse2 or scalar\n";
+            std::cerr << "   --verify-probe      check every probe against the scalar kernel and stop on a difference\n";
+            std::cerr << "   --sweep list        simulate many caches in one pass and print a summary for each; list is\n";
+            std::cerr << "                       comma separated SETSxWAYSxLINE entries where any field may be a range lo-hi\n";
+            std::cerr << "                       (powers of two for sets and line size), e.g. 64-8192x1-8x32,16x4x16-128\n";
+            std::cerr << "   --threads n         simulate the caches of a sweep, or the cores of a multi-core trace, on n threads;\n";
+            std::cerr << "                       0 uses every core (default 1)\n";
+            std::cerr << "   --summary-only      print the configuration and summary without the per-reference rows\n";
+            std::cerr << "   --generic-kernel    use the access code with run-time ways instead of the per-associativity copies\n";
+            std::cerr << "   --stack-distance n  report LRU results for 1 to n ways of trace.config's sets in one pass\n";
+            std::cerr << "   --classify-misses   name every data cache miss compulsory, capacity or conflict\n";
+            std::cerr << "   --set-stats file    write the accesses, misses and evictions of every set to file at the end;\n";
+            std::cerr << "                       JSON if file ends in .json, CSV otherwise\n";
+            std::cerr << "   --interval n        with --interval-stats file, write the misses of every n data cache accesses\n";
+            std::cerr << "   --save-state file   write a checkpoint of the caches to file at the end of the trace\n";
+            std::cerr << "   --save-every n      also write it after every n references\n";
+            std::cerr << "   --load-state file   resume from a checkpoint, passing over the references it already covers\n";
+            std::cerr << "   --warm-state file   start with the cache contents of a checkpoint and every counter at zero\n";
+            std::cerr << "   --sample-sets k     simulate about one set in k and estimate the hit and miss ratios\n";
+            std::cerr << "   --sample-time w:p:u simulate w references at the end of every p, after u uncounted warm-up\n";
+            std::cerr << "                       references (default all of the rest), and estimate the ratios\n";
+            std::cerr << "   --sharing-stats file with several cores, write the invalidations, coherence and false sharing misses\n";
+            std::cerr << "                       of every line they shared to file; JSON if file ends in .json, CSV otherwise\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (stackDistanceWays > 0 && !sweepGeometries.empty())
+    {
+        std::cerr << "--stack-distance and --sweep cannot be combined\n";
+        exit(EXIT_FAILURE);
+    }
+    if (classifyMisses && (stackDistanceWays > 0 || !sweepGeometries.empty()))
+    {
+        std::cerr << "--classify-misses needs a single cache, not --sweep or --stack-distance\n";
+        exit(EXIT_FAILURE);
+    }
+    if ((intervalLength > 0) != (intervalStatsFileName != NULL))
+    {
+        std::cerr << "--interval and --interval-stats must be given together\n";
+        exit(EXIT_FAILURE);
+    }
+    if ((setStatsFileName != NULL || intervalStatsFileName != NULL) && (stackDistanceWays > 0 || !sweepGeometries.empty()))
+    {
+        std::cerr << "--set-stats and --interval-stats need a single cache, not --sweep or --stack-distance\n";
+        exit(EXIT_FAILURE);
+    }
+    if (setSampleRatio > 0 && timeSampleWindow > 0)
+    {
+        std::cerr << "--sample-sets and --sample-time cannot be combined\n";
+        exit(EXIT_FAILURE);
+    }
+    if ((setSampleRatio > 0 || timeSampleWindow > 0) &&
+        (stackDistanceWays > 0 || !sweepGeometries.empty() || saveStateFileName != NULL || loadStateFileName != NULL ||
+         classifyMisses))
+    {
+        std::cerr << "Sampling needs a single cache and cannot be combined with checkpoints or --classify-misses\n";
+        exit(EXIT_FAILURE);
+    }
+    if (saveStateInterval > 0 && saveStateFileName == NULL)
+    {
+        std::cerr << "--save-every needs --save-state\n";
+        exit(EXIT_FAILURE);
+    }
+    if ((saveStateFileName != NULL || loadStateFileName != NULL) && (stackDistanceWays > 0 || !sweepGeometries.empty()))
+    {
+        std::cerr << "Checkpoints need a single cache, not --sweep or --stack-distance\n";
+        exit(EXIT_FAILURE);
+    }
+    tagMatch = SelectTagMatchKernel(probeName);
+}
+
+
+
+//Reads the configuration file and assigns values to program variables.
+//The first three lines are assumed to be valid for this program.  Optional settings may follow:
+//   Replacement policy: LRU | tree-PLRU | NRU | FIFO | random | SRRIP | BRRIP      (default LRU)
+//   L2 sets: n, L2 set size: n, L2 line size: n, L2 replacement policy: name      (a level below; also L3, L4)
+//   Inclusion: NINE | inclusive | exclusive                                         (default NINE)
+//   Write policy: write-back | write-through                                        (default write-back)
+//   Write miss policy: write-allocate | no-write-allocate                           (default write-allocate)
+//   Write buffer: n                                                                 (lines, default none)
+//   Sector size: n                                                                  (bytes, default the line size)
+//   Prefetcher: none | next-line | stride | stream                                  (default none)
+//   Prefetch degree: n, Prefetch latency: n                          (lines per prediction, references; default 1, 0)
+//   Cores: n                                                                        (private data caches, default 1)
+//   Coherence: MESI | MOESI                                                         (default MESI)
+void ReadConfig()
+{
+    std::ifstream inConfigFile("trace.config",std::ios::in);
+    if (!inConfigFile)
+    {
+        std::cerr << "Configuration file could not be opened\n";
+        exit(EXIT_FAILURE);
+    }
+    inConfigFile.seekg(std::ios::beg);
+    
+    //iterate through the line until the ":" is found
+    char searchChar = '\0';
+    
+    while (searchChar != ':')
+    {
+        searchChar = inConfigFile.get();
+    }
+    inConfigFile >> numSets; //read the numSets line
+    searchChar = '\0';
+    
+    //continue to the next line until next ':' is found
+    while (searchChar != ':')
+    {
+        searchChar = inConfigFile.get();
+    }
+    inConfigFile >> associativityLevel; //read the numSets line
+    searchChar = '\0';
+    
+    //continue to the next line until next ':' is found
+    while (searchChar != ':')
+    {
+        searchChar = inConfigFile.get();
+    }
+    inConfigFile >> lineSize; //read the numSets line
+    searchChar = '\0';
+    
+    //Any further lines are optional "Name: value" settings
+    std::string configLine, configName, configValue;
+    while (std::getline(inConfigFile, configLine))
+    {
+        if (!SplitConfigLine(configLine, configName, configValue))
+            continue; //blank line or the end of the line size line
+        
+        if (strcasecmp(configName.c_str(), "Replacement policy") == 0)
+        {
+            if (!ParseReplacementPolicy(configValue, replacementPolicy))
+            {
+                std::cerr << "Unknown replacement policy " << configValue << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcasecmp(configName.c_str(), "Inclusion") == 0)
+        {
+            if (!ParseInclusionPolicy(configValue, inclusionPolicy))
+            {
+                std::cerr << "Unknown inclusion policy " << configValue << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcasecmp(configName.c_str(), "Write policy") == 0)
+        {
+            if (strcasecmp(configValue.c_str(), "write-back") == 0)
+                writeThrough = false;
+            else if (strcasecmp(configValue.c_str(), "write-through") == 0)
+                writeThrough = true;
+            else
+            {
+                std::cerr << "Unknown write policy " << configValue << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcasecmp(configName.c_str(), "Write miss policy") == 0)
+        {
+            if (strcasecmp(configValue.c_str(), "write-allocate") == 0)
+                writeAllocate = true;
+            else if (strcasecmp(configValue.c_str(), "no-write-allocate") == 0)
+                writeAllocate = false;
+            else
+            {
+                std::cerr << "Unknown write miss policy " << configValue << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcasecmp(configName.c_str(), "Write buffer") == 0)
+            writeBufferEntries = strtoul(configValue.c_str(), NULL, 10);
+        else if (strcasecmp(configName.c_str(), "Sector size") == 0)
+            sectorSize = strtoul(configValue.c_str(), NULL, 10);
+        else if (strcasecmp(configName.c_str(), "Prefetcher") == 0)
+        {
+            if (!ParsePrefetcherKind(configValue, prefetcherKind))
+            {
+                std::cerr << "Unknown prefetcher " << configValue << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (strcasecmp(configName.c_str(), "Prefetch degree") == 0)
+            prefetchDegree = strtoul(configValue.c_str(), NULL, 10);
+        else if (strcasecmp(configName.c_str(), "Prefetch latency") == 0)
+            prefetchLatency = strtoul(configValue.c_str(), NULL, 10);
+        else if (strcasecmp(configName.c_str(), "Cores") == 0)
+            numCores = strtoul(configValue.c_str(), NULL, 10);
+        else if (strcasecmp(configName.c_str(), "Coherence") == 0)
+        {
+            if (!ParseCoherenceProtocol(configValue, coherenceProtocol))
+            {
+                std::cerr << "Unknown coherence protocol " << configValue << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (ParseLevelSetting(configName, configValue))
+            continue;
+        else
+        {
+            std::cerr << "Unknown configuration setting " << configName << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    
+    //Finished with configuration file
+    inConfigFile.close();
+    
+    //the cache storage packs one bit per way, so the extents are hard limits
+    if (numSets < 1 || numSets > MAX_SETS || associativityLevel < 1 || associativityLevel > MAX_ASSOCIATIVITY)
+    {
+        std::cerr << "Configuration is outside the supported range of " << MAX_SETS << " sets and " <<
+            MAX_ASSOCIATIVITY << " ways\n";
+        exit(EXIT_FAILURE);
+    }
+    if (replacementPolicy == POLICY_TREE_PLRU && (associativityLevel & (associativityLevel - 1)) != 0)
+    {
+        std::cerr << "tree-PLRU replacement needs a power of two set size\n";
+        exit(EXIT_FAILURE);
+    }
+    for (size_t level = 0; level < lowerLevelConfigs.size(); ++level)
+    {
+        const CacheGeometry & geometry = lowerLevelConfigs[level].geometry;
+        size_t upperLineSize = (level == 0) ? lineSize : lowerLevelConfigs[level - 1].geometry.lineSize;
+        if (geometry.numSets < 1 || geometry.numSets > MAX_SETS || (geometry.numSets & (geometry.numSets - 1)) != 0 ||
+            geometry.associativityLevel < 1 || geometry.associativityLevel > MAX_ASSOCIATIVITY ||
+            (geometry.lineSize & (geometry.lineSize - 1)) != 0 || geometry.lineSize < upperLineSize)
+        {
+            std::cerr << "L" << level + 2 << " needs a power of two number of sets up to " << MAX_SETS << ", 1 to " <<
+                MAX_ASSOCIATIVITY << " ways and a power of two line size no smaller than the level above\n";
+            exit(EXIT_FAILURE);
+        }
+        size_t ways = geometry.associativityLevel;
+        if (lowerLevelConfigs[level].policy == POLICY_TREE_PLRU && (ways & (ways - 1)) != 0)
+        {
+            std::cerr << "tree-PLRU replacement needs a power of two set size\n";
+            exit(EXIT_FAILURE);
+        }
+        if (inclusionPolicy == INCLUSION_EXCLUSIVE && geometry.lineSize != lineSize)
+        {
+            std::cerr << "Exclusive levels need the same line size at every level\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (writeBufferEntries > MAX_WRITE_BUFFER_ENTRIES)
+    {
+        std::cerr << "Write buffer is limited to " << MAX_WRITE_BUFFER_ENTRIES << " entries\n";
+        exit(EXIT_FAILURE);
+    }
+    if (sectorSize != 0 && (sectorSize > lineSize || (sectorSize & (sectorSize - 1)) != 0 ||
+                            lineSize / sectorSize > MAX_SECTORS_PER_LINE))
+    {
+        std::cerr << "Sector size must be a power of two that splits a line into at most " << MAX_SECTORS_PER_LINE <<
+            " sectors\n";
+        exit(EXIT_FAILURE);
+    }
+    if (prefetchDegree < 1 || prefetchDegree > MAX_PREFETCH_DEGREE || prefetchLatency > MAX_PREFETCH_LATENCY)
+    {
+        std::cerr << "Prefetch degree must be 1 to " << MAX_PREFETCH_DEGREE << " and prefetch latency at most " <<
+            MAX_PREFETCH_LATENCY << "\n";
+        exit(EXIT_FAILURE);
+    }
+    if (prefetcherKind != PREFETCH_NONE && sectorSize != 0)
+    {
+        std::cerr << "Prefetchers fill whole lines and need unsectored lines\n";
+        exit(EXIT_FAILURE);
+    }
+    if (inclusionPolicy == INCLUSION_EXCLUSIVE && !lowerLevelConfigs.empty() &&
+        (writeThrough || writeBufferEntries > 0 || sectorSize != 0 || prefetcherKind != PREFETCH_NONE))
+    {
+        //an exclusive level must take whole lines as soon as the data cache gives them up
+        std::cerr << "Exclusive levels need write-back stores, unsectored lines, no write buffer and no prefetcher\n";
+        exit(EXIT_FAILURE);
+    }
+    if (prefetcherKind != PREFETCH_NONE && (!sweepGeometries.empty() || stackDistanceWays > 0))
+    {
+        std::cerr << "--sweep and --stack-distance do not model prefetching\n";
+        exit(EXIT_FAILURE);
+    }
+    if (sectorSize != 0 && (!sweepGeometries.empty() || stackDistanceWays > 0))
+    {
+        std::cerr << "--sweep and --stack-distance model unsectored lines only\n";
+        exit(EXIT_FAILURE);
+    }
+    if (classifyMisses && sectorSize != 0) //a sector miss on a present line fits none of the three classes
+    {
+        std::cerr << "--classify-misses needs unsectored lines\n";
+        exit(EXIT_FAILURE);
+    }
+    if ((saveStateInterval > 0 || (loadStateFileName != NULL && !warmStart)) &&
+        (writeBufferEntries > 0 || prefetcherKind != PREFETCH_NONE || classifyMisses || setStatsFileName != NULL ||
+         intervalStatsFileName != NULL))
+    {
+        //a run resumed from the middle of a trace would continue without this state, which a checkpoint does not hold
+        std::cerr << "--save-every and --load-state cannot be combined with a write buffer, a prefetcher, --classify-misses"
+            " or per-set statistics\n";
+        exit(EXIT_FAILURE);
+    }
+    if (!lowerLevelConfigs.empty() && (!sweepGeometries.empty() || stackDistanceWays > 0))
+    {
+        std::cerr << "--sweep and --stack-distance model a single cache, not a hierarchy\n";
+        exit(EXIT_FAILURE);
+    }
+    if (stackDistanceWays > 0 && replacementPolicy != POLICY_LRU)
+    {
+        std::cerr << "--stack-distance models LRU replacement only\n";
+        exit(EXIT_FAILURE);
+    }
+    if (stackDistanceWays > 0 && !writeAllocate) //every reference has to enter the stack
+    {
+        std::cerr << "--stack-distance models write-allocate stores only\n";
+        exit(EXIT_FAILURE);
+    }
+    if (numCores < 1 || numCores > MAX_CORES)
+    {
+        std::cerr << "Cores must be 1 to " << MAX_CORES << "\n";
+        exit(EXIT_FAILURE);
+    }
+    if (numCores > 1 &&
+        (!lowerLevelConfigs.empty() || writeThrough || !writeAllocate || writeBufferEntries > 0 || sectorSize != 0 ||
+         prefetcherKind != PREFETCH_NONE || !sweepGeometries.empty() || stackDistanceWays > 0 || classifyMisses ||
+         setStatsFileName != NULL || intervalStatsFileName != NULL || saveStateFileName != NULL ||
+         loadStateFileName != NULL || setSampleRatio > 0 || timeSampleWindow > 0))
+    {
+        //the protocol works on whole lines of write-back, write-allocate caches with memory right below them
+        std::cerr << "Several cores need write-back, write-allocate, unsectored caches with no levels below, write buffer"
+            " or prefetcher, and cannot be combined with --sweep, --stack-distance, --classify-misses, per-set"
+            " statistics, checkpoints or sampling\n";
+        exit(EXIT_FAILURE);
+    }
+    if (sharingStatsFileName != NULL && numCores < 2)
+    {
+        std::cerr << "--sharing-stats needs more than one core in trace.config\n";
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < sweepGeometries.size(); ++i)
+    {
+        size_t ways = sweepGeometries[i].associativityLevel;
+        if (replacementPolicy == POLICY_TREE_PLRU && (ways & (ways - 1)) != 0)
+        {
+            std::cerr << "tree-PLRU replacement needs a power of two set size\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+
+//Splits a "Name: value" configuration line, trimming spaces around both parts.
+//Returns FALSE if the line has no ':' or no value.
+bool SplitConfigLine(const std::string & line, std::string & name, std::string & value)
+{
+    const char *spaces = " \t\r";
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+        return false;
+    
+    size_t nameStart = line.find_first_not_of(spaces);
+    size_t nameEnd = line.find_last_not_of(spaces, colon - 1);
+    name = (nameStart < colon && nameEnd != std::string::npos) ? line.substr(nameStart, nameEnd - nameStart + 1) : "";
+    
+    size_t valueStart = line.find_first_not_of(spaces, colon + 1);
+    if (valueStart == std::string::npos)
+        return false;
+    size_t valueEnd = line.find_last_not_of(spaces);
+    value = line.substr(valueStart, valueEnd - valueStart + 1);
+    return true;
+}
+
+
+
+//Reads an "Ln sets", "Ln set size", "Ln line size" or "Ln replacement policy" setting of a level below the data
+//cache.  Returns FALSE if name is not a level setting.
+bool ParseLevelSetting(const std::string & name, const std::string & value)
+{
+    if (name.size() < 4 || (name[0] != 'L' && name[0] != 'l') || name[1] < '2' ||
+        static_cast<size_t>(name[1] - '0') > MAX_CACHE_LEVELS || name[2] != ' ')
+        return false;
+    
+    size_t level = name[1] - '2';
+    if (lowerLevelConfigs.size() <= level)
+    {
+        LevelConfig unset = {{0, 0, 0}, POLICY_LRU}; //missing fields are caught by the range checks
+        lowerLevelConfigs.resize(level + 1, unset);
+    }
+    LevelConfig & config = lowerLevelConfigs[level];
+    
+    const char *setting = name.c_str() + 3;
+    if (strcasecmp(setting, "replacement policy") == 0)
+    {
+        if (!ParseReplacementPolicy(value, config.policy))
+        {
+            std::cerr << "Unknown replacement policy " << value << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (strcasecmp(setting, "sets") == 0)
+        config.geometry.numSets = strtoul(value.c_str(), NULL, 10);
+    else if (strcasecmp(setting, "set size") == 0)
+        config.geometry.associativityLevel = strtoul(value.c_str(), NULL, 10);
+    else if (strcasecmp(setting, "line size") == 0)
+        config.geometry.lineSize = strtoul(value.c_str(), NULL, 10);
+    else
+        return false;
+    return true;
+}
+
+
+
+//Converts an inclusion policy name from trace.config.  Returns FALSE if the name is not known.
+bool ParseInclusionPolicy(const std::string & name, InclusionPolicy & policy)
+{
+    const char *value = name.c_str();
+    if (strcasecmp(value, "NINE") == 0)
+        policy = INCLUSION_NINE;
+    else if (strcasecmp(value, "inclusive") == 0)
+        policy = INCLUSION_INCLUSIVE;
+    else if (strcasecmp(value, "exclusive") == 0)
+        policy = INCLUSION_EXCLUSIVE;
+    else
+        return false;
+    return true;
+}
+
+const char * InclusionPolicyName(InclusionPolicy policy)
+{
+    switch (policy)
+    {
+        case INCLUSION_NINE:        return "non-inclusive non-exclusive";
+        case INCLUSION_INCLUSIVE:   return "inclusive";
+        case INCLUSION_EXCLUSIVE:   return "exclusive";
+    }
+    return "unknown";
+}
+
+
+
+//Prints the configuration information to the
+void PrintConfig()
+{
+    std::cout << "Cache Configuration\n\n";
+    std::cout << "   " << numSets << " " << associativityLevel << "-way set associative entries\n";
+    std::cout << "   of line size " << lineSize << " bytes\n";
+    if (replacementPolicy != POLICY_LRU) //LRU is the original model and keeps the original output
+        std::cout << "   with " << ReplacementPolicyName(replacementPolicy) << " replacement\n";
+    for (size_t level = 0; level < lowerLevelConfigs.size(); ++level) //only present for a hierarchy
+    {
+        const LevelConfig & config = lowerLevelConfigs[level];
+        std::cout << "   L" << level + 2 << ": " << config.geometry.numSets << " " << config.geometry.associativityLevel <<
+            "-way set associative entries of line size " << config.geometry.lineSize << " bytes";
+        if (config.policy != POLICY_LRU)
+            std::cout << ", " << ReplacementPolicyName(config.policy) << " replacement";
+        std::cout << "\n";
+    }
+    if (!lowerLevelConfigs.empty())
+        std::cout << "   with " << InclusionPolicyName(inclusionPolicy) << " levels\n";
+    if (writeThrough || !writeAllocate) //write-back, write-allocate is the original model
+        std::cout << "   with " << (writeThrough ? "write-through" : "write-back") << " and " <<
+            (writeAllocate ? "write-allocate" : "no-write-allocate") << " stores\n";
+    if (writeBufferEntries > 0)
+        std::cout << "   with a write buffer of " << writeBufferEntries << " lines\n";
+    if (sectorSize != 0)
+        std::cout << "   with sectors of " << sectorSize << " bytes\n";
+    if (prefetcherKind != PREFETCH_NONE)
+    {
+        std::cout << "   with " << PrefetcherKindName(prefetcherKind) << " prefetching of " << prefetchDegree << " lines";
+        if (prefetchLatency > 0)
+            std::cout << " that arrive " << prefetchLatency << " references later";
+        std::cout << "\n";
+    }
+    if (numCores > 1)
+        std::cout << "   for each of " << numCores << " cores, kept coherent by " << CoherenceProtocolName(coherenceProtocol) << "\n";
+    std::cout << "\n\n";
+}
+
+
+
+//Prints the summary statistics
+void PrintSummary(size_t hitCounter, size_t missCounter, size_t refCounter, const MissClassifier *missClassifier)
+{
+    std::cout << "\n\nSimulation Summary Statistics\n";
+    std::cout << "-----------------------------\n";
+    std::cout << "Total hits       : " << hitCounter << "\n";
+    std::cout << "Total misses     : " << missCounter << "\n";
+    std::cout << "Total accesses   : " << refCounter << "\n";
+    float hitRatio = static_cast<float>(hitCounter) / refCounter;
+    float missRatio = static_cast<float>(missCounter) / refCounter;
+    std::cout << "Hit ratio        : " << std::fixed << std::setprecision(6) << hitRatio << "\n";
+    std::cout << "Miss ratio       : " << std::fixed << std::setprecision(6) << missRatio << "\n";
+    if (missClassifier != NULL)
+    {
+        std::cout << "Compulsory misses: " << missClassifier->Compulsory() << "\n";
+        std::cout << "Capacity misses  : " << missClassifier->Capacity() << "\n";
+        std::cout << "Conflict misses  : " << missClassifier->Conflict() << "\n";
+    }
+    std::cout << "\n";
+}
+
+
+
+//Prints the statistics of every level of a hierarchy and its main memory traffic
+void PrintHierarchySummary(const SimulationState & state)
+{
+    std::cout << "Cache Hierarchy Statistics\n";
+    std::cout << "--------------------------\n";
+    std::cout << "Level         Hits       Misses     Accesses   Writebacks  Invalidated\n";
+    std::cout << "----- ------------ ------------ ------------ ------------ ------------\n";
+    for (size_t level = 0; level <= state.lowerLevels.size(); ++level)
+    {
+        const CacheModel & cache = (level == 0) ? state.caches[0] : state.lowerLevels[level - 1];
+        std::cout << std::right << std::dec;
+        std::cout << std::setw(4) << "L" << level + 1;
+        std::cout << std::setw(13) << cache.hitCounter;
+        std::cout << std::setw(13) << cache.missCounter;
+        std::cout << std::setw(13) << cache.refCounter;
+        std::cout << std::setw(13) << cache.writebackCounter;
+        std::cout << std::setw(13) << cache.invalidationCounter << "\n";
+    }
+    std::cout << "\n";
+    PrintMemoryTraffic(state);
+}
+
+
+
+//Prints the lines read from and written to main memory, and what the write buffer saved
+void PrintMemoryTraffic(const SimulationState & state)
+{
+    //a sectored data cache talks to memory in groups of sectors rather than lines
+    const char *unit = (state.lowerLevels.empty() && state.caches[0].sectored) ? " transfers, " : " lines, ";
+    std::cout << "Memory reads     : " << state.memoryReads << unit << state.memoryReadBytes << " bytes\n";
+    std::cout << "Memory writes    : " << state.memoryWrites << unit << state.memoryWriteBytes << " bytes\n";
+    if (state.writeBuffer.Entries() > 0)
+        std::cout << "Write buffer     : " << state.writeBuffer.Writes() << " writes, " << state.writeBuffer.Combined() <<
+            " combined\n";
+    std::cout << "\n";
+}
+
+
+
+//Prints how well the prefetcher did.  Accuracy is the share of prefetched lines that were used, coverage the share
+//of would-be misses they removed, and timeliness the share of correct prefetches that arrived in time.
+void PrintPrefetchSummary(const SimulationState & state)
+{
+    size_t useful = state.prefetchUseful;
+    size_t issued = state.prefetchIssued;
+    size_t lineBytes = state.caches[0].geometry.lineSize;
+    float accuracy = (issued > 0) ? static_cast<float>(useful) / issued : 0;
+    float coverage = (useful > 0) ? static_cast<float>(useful) / (useful + state.caches[0].missCounter) : 0;
+    float timeliness = (useful > 0) ? static_cast<float>(useful) / (useful + state.prefetchLate) : 0;
+    
+    std::cout << "Prefetcher Statistics\n";
+    std::cout << "---------------------\n";
+    std::cout << "Prefetches issued: " << issued << "\n";
+    std::cout << "Useful prefetches: " << useful << "\n";
+    std::cout << "Late prefetches  : " << state.prefetchLate << "\n";
+    std::cout << "Accuracy         : " << std::fixed << std::setprecision(6) << accuracy << "\n";
+    std::cout << "Coverage         : " << std::fixed << std::setprecision(6) << coverage << "\n";
+    std::cout << "Timeliness       : " << std::fixed << std::setprecision(6) << timeliness << "\n";
+    std::cout << "Prefetch traffic : " << issued << " lines, " << issued * lineBytes << " bytes, " << issued - useful <<
+        " lines never used\n\n";
+}
+
+
+
+//Writes the per-set counters and the interval samples to the files named on the command line.  Every dirty line
+//the data cache evicted was written back, so the dirty evictions of the sets must add up to its writebacks; a
+//debug build checks that.
+void WriteSetStatistics(SetStatistics & statistics, const size_t writebacks)
+{
+    statistics.Finish();
+    if (setStatsFileName != NULL)
+    {
+        std::ofstream out(setStatsFileName);
+        statistics.WriteSets(out, IsJsonFileName(setStatsFileName));
+        if (!out)
+        {
+            std::cerr << "Cannot write " << setStatsFileName << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (intervalStatsFileName != NULL)
+    {
+        std::ofstream out(intervalStatsFileName);
+        statistics.WriteIntervals(out, IsJsonFileName(intervalStatsFileName));
+        if (!out)
+        {
+            std::cerr << "Cannot write " << intervalStatsFileName << "\n";
+            exit(EXIT_FAILURE);
+        }
+    }
+    std::cout.flush(); //a failed assert aborts without flushing, so the summary goes out first
+    assert(statistics.DirtyEvictions() == writebacks); //checked after the files are written, so a run never loses them
+    (void)writebacks; //unused when NDEBUG removes the assert
+}
+
+
+
+//Lists the settings a checkpoint depends on; a checkpoint is only restored under the same list
+void CheckpointConfiguration(std::vector<uint64_t> & configuration)
+{
+    configuration.push_back(numSets);
+    configuration.push_back(associativityLevel);
+    configuration.push_back(lineSize);
+    configuration.push_back(replacementPolicy);
+    configuration.push_back(sectorSize);
+    configuration.push_back(writeThrough);
+    configuration.push_back(writeAllocate);
+    configuration.push_back(inclusionPolicy);
+    configuration.push_back(lowerLevelConfigs.size());
+    for (size_t level = 0; level < lowerLevelConfigs.size(); ++level)
+    {
+        configuration.push_back(lowerLevelConfigs[level].geometry.numSets);
+        configuration.push_back(lowerLevelConfigs[level].geometry.associativityLevel);
+        configuration.push_back(lowerLevelConfigs[level].geometry.lineSize);
+        configuration.push_back(lowerLevelConfigs[level].policy);
+    }
+}
+
+
+
+//Writes the contents and counters of every cache, and the memory traffic, to a checkpoint file
+void SaveCheckpoint(const SimulationState & state, const char *fileName)
+{
+    CheckpointWriter checkpoint;
+    std::vector<uint64_t> configuration;
+    CheckpointConfiguration(configuration);
+    checkpoint.AddVector(configuration);
+    checkpoint.AddValue(state.memoryReads);
+    checkpoint.AddValue(state.memoryWrites);
+    checkpoint.AddValue(state.memoryReadBytes);
+    checkpoint.AddValue(state.memoryWriteBytes);
+    for (size_t level = 0; level <= state.lowerLevels.size(); ++level)
+    {
+        const CacheModel & cache = (level == 0) ? state.caches[0] : state.lowerLevels[level - 1];
+        checkpoint.AddValue(cache.hitCounter);
+        checkpoint.AddValue(cache.missCounter);
+        checkpoint.AddValue(cache.refCounter);
+        checkpoint.AddValue(cache.writebackCounter);
+        checkpoint.AddValue(cache.invalidationCounter);
+        cache.cacheAssociation.Save(checkpoint);
+    }
+    checkpoint.Write(fileName, state.tracePosition);
+}
+
+
+
+//Restores a checkpoint written by SaveCheckpoint() into caches already built for trace.config.  A warm start keeps
+//only the cache contents; otherwise the counters are restored too and the references the checkpoint covers are
+//passed over.  Exits if the checkpoint was written for another configuration.
+void LoadCheckpoint(SimulationState & state, const char *fileName, bool warm)
+{
+    CheckpointReader checkpoint;
+    checkpoint.Open(fileName);
+
+    std::vector<uint64_t> configuration;
+    CheckpointConfiguration(configuration);
+    std::vector<uint64_t> savedConfiguration(configuration.size());
+    bool restored = checkpoint.ReadVector(savedConfiguration) && savedConfiguration == configuration &&
+                    checkpoint.ReadValue(state.memoryReads) && checkpoint.ReadValue(state.memoryWrites) &&
+                    checkpoint.ReadValue(state.memoryReadBytes) && checkpoint.ReadValue(state.memoryWriteBytes);
+    for (size_t level = 0; restored && level <= state.lowerLevels.size(); ++level)
+    {
+        CacheModel & cache = (level == 0) ? state.caches[0] : state.lowerLevels[level - 1];
+        restored = checkpoint.ReadValue(cache.hitCounter) && checkpoint.ReadValue(cache.missCounter) &&
+                   checkpoint.ReadValue(cache.refCounter) && checkpoint.ReadValue(cache.writebackCounter) &&
+                   checkpoint.ReadValue(cache.invalidationCounter) && cache.cacheAssociation.Restore(checkpoint);
+        if (warm)
+        {
+            cache.hitCounter = 0;
+            cache.missCounter = 0;
+            cache.refCounter = 0;
+            cache.writebackCounter = 0;
+            cache.invalidationCounter = 0;
+        }
+    }
+    if (!restored || !checkpoint.AtEnd())
+    {
+        std::cerr << "Checkpoint " << fileName << " was written for a different trace.config\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (warm)
+    {
+        state.memoryReads = 0;
+        state.memoryWrites = 0;
+        state.memoryReadBytes = 0;
+        state.memoryWriteBytes = 0;
+    }
+    else
+    {
+        state.resumePosition = checkpoint.References();
+        if (saveStateInterval > 0) //periodic checkpoints stay on the same reference counts as an uninterrupted run
+            state.nextCheckpoint = (state.resumePosition / saveStateInterval + 1) * saveStateInterval;
+    }
+}
+
+
+
+//Prints the hit and miss ratios a sampled run estimates for the whole trace, with their 95% confidence intervals,
+//and the hits and misses they extrapolate to
+void PrintSampledSummary(const SimulationState & state)
+{
+    Sampler sampler = *state.sampler;
+    const CacheModel & dataCache = state.caches[0];
+    sampler.Finish(dataCache.refCounter, dataCache.missCounter);
+    std::vector<SampleCounts> samples = sampler.Samples();
+    
+    size_t sampledAccesses = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+        sampledAccesses += samples[i].accesses;
+    
+    double totalAccesses; //every access of the trace; time sampling has to estimate it from the windows
+    double populationSize;
+    std::cout << "\n\nSampled Simulation Summary Statistics\n";
+    std::cout << "-------------------------------------\n";
+    if (sampler.SamplesSets())
+    {
+        totalAccesses = static_cast<double>(sampledAccesses + sampler.SkippedAccesses());
+        populationSize = static_cast<double>(numSets);
+        std::cout << "Sampled sets     : " << sampler.SampledSetCount() << " of " << numSets << "\n";
+        std::cout << "Sampled accesses : " << sampledAccesses << " of " << sampledAccesses + sampler.SkippedAccesses() << "\n";
+    }
+    else
+    {
+        size_t measured = sampler.MeasuredReferences();
+        totalAccesses = (measured > 0) ? static_cast<double>(sampledAccesses) * state.tracePosition / measured : 0;
+        populationSize = static_cast<double>(state.tracePosition) / sampler.Window();
+        std::cout << "Sampled windows  : " << samples.size() << " windows of " << sampler.Window() << " references every " <<
+            sampler.Period() << ", after " << sampler.Warmup() << " warm-up\n";
+        std::cout << "Sampled refs     : " << measured << " of " << state.tracePosition << "\n";
+        std::cout << "Sampled accesses : " << sampledAccesses << "\n";
+    }
+    
+    SampleEstimate estimate = EstimateMissRatio(samples, populationSize);
+    std::cout << "Hit ratio        : " << std::fixed << std::setprecision(6) << 1.0 - estimate.missRatio;
+    if (estimate.halfWidth >= 0)
+        std::cout << " +/- " << estimate.halfWidth << " (95% confidence)";
+    std::cout << "\n";
+    std::cout << "Miss ratio       : " << std::fixed << std::setprecision(6) << estimate.missRatio;
+    if (estimate.halfWidth >= 0)
+        std::cout << " +/- " << estimate.halfWidth << " (95% confidence)";
+    else
+        std::cout << " (too few samples for a confidence interval)";
+    std::cout << "\n";
+    std::cout << std::setprecision(0);
+    std::cout << "Estimated hits   : " << (1.0 - estimate.missRatio) * totalAccesses << "\n";
+    std::cout << "Estimated misses : " << estimate.missRatio * totalAccesses << "\n";
+    if (!sampler.SamplesSets())
+        std::cout << "Estimated total  : " << totalAccesses << " accesses\n";
+    std::cout << "\n";
+}
+
+
+
+//Prints the counters of every core, the bus and memory traffic of all of them, and the lines with the most false
+//sharing.  A coherence miss is a miss on a line the core lost to another core's write; a false sharing miss is one
+//that touches none of the bytes other cores wrote since.
+void PrintCoherenceSummary(const CoherenceModel & model)
+{
+    CoreCounters total;
+    size_t invalidations = 0;
+    std::cout << "Coherence Statistics\n";
+    std::cout << "--------------------\n";
+    std::cout << "Core         Hits       Misses     Accesses    Coherence  False share  Invalidated   Writebacks\n";
+    std::cout << "---- ------------ ------------ ------------ ------------ ------------ ------------ ------------\n";
+    for (size_t core = 0; core < model.cores.size(); ++core)
+    {
+        const CacheModel & cache = model.cores[core].cache;
+        const CoreCounters & counters = model.cores[core].counters;
+        std::cout << std::right << std::dec;
+        std::cout << std::setw(4) << core;
+        std::cout << std::setw(13) << cache.hitCounter;
+        std::cout << std::setw(13) << cache.missCounter;
+        std::cout << std::setw(13) << cache.refCounter;
+        std::cout << std::setw(13) << counters.coherenceMisses;
+        std::cout << std::setw(13) << counters.falseSharingMisses;
+        std::cout << std::setw(13) << cache.invalidationCounter;
+        std::cout << std::setw(13) << cache.writebackCounter << "\n";
+        
+        total.busReads += counters.busReads;
+        total.busReadExclusives += counters.busReadExclusives;
+        total.busUpgrades += counters.busUpgrades;
+        total.cacheToCache += counters.cacheToCache;
+        total.memoryReads += counters.memoryReads;
+        total.memoryWrites += counters.memoryWrites;
+        total.coherenceMisses += counters.coherenceMisses;
+        total.falseSharingMisses += counters.falseSharingMisses;
+        invalidations += cache.invalidationCounter;
+    }
+    
+    size_t lineBytes = model.cores[0].cache.geometry.lineSize;
+    std::cout << "\n";
+    std::cout << "Bus reads        : " << total.busReads << "\n";
+    std::cout << "Bus read-owns    : " << total.busReadExclusives << "\n";
+    std::cout << "Bus upgrades     : " << total.busUpgrades << "\n";
+    std::cout << "Invalidations    : " << invalidations << "\n";
+    std::cout << "Cache to cache   : " << total.cacheToCache << " lines\n";
+    std::cout << "Memory reads     : " << total.memoryReads << " lines, " << total.memoryReads * lineBytes << " bytes\n";
+    std::cout << "Memory writes    : " << total.memoryWrites << " lines, " << total.memoryWrites * lineBytes << " bytes\n";
+    std::cout << "Coherence misses : " << total.coherenceMisses << ", " << total.falseSharingMisses << " of them false sharing\n";
+    std::cout << "Private accesses : " << model.privateAccesses << " of " << model.privateAccesses + model.sharedAccesses;
+    if (model.parallelRuns > 0)
+        std::cout << ", " << model.parallelRuns << " runs of them simulated in parallel";
+    std::cout << "\n\n";
+    
+    std::vector<std::pair<uint64_t, LineSharing> > hotspots = model.sharing.Hotspots(10);
+    if (hotspots.empty())
+        return;
+    unsigned int lineShift = model.cores[0].cache.offsetShamt;
+    std::cout << "False Sharing Hotspots\n";
+    std::cout << "----------------------\n";
+    std::cout << "    Line  Invalidated    Coherence  False share  Cores\n";
+    std::cout << "-------- ------------ ------------ ------------  -----\n";
+    for (size_t i = 0; i < hotspots.size(); ++i)
+    {
+        const LineSharing & sharing = hotspots[i].second;
+        std::cout << std::right << std::hex << std::setw(8) << (hotspots[i].first << lineShift) << std::dec;
+        std::cout << std::setw(13) << sharing.invalidations;
+        std::cout << std::setw(13) << sharing.coherenceMisses;
+        std::cout << std::setw(13) << sharing.falseSharingMisses;
+        std::cout << "  " << SharingTracker::CoreList(sharing.cores, " ") << "\n";
+    }
+    std::cout << "\n";
+}
+
+
+
+//Writes the sharing counters of every line several cores touched to the file named on the command line
+void WriteSharingStatistics(const CoherenceModel & model)
+{
+    std::ofstream out(sharingStatsFileName);
+    model.sharing.Write(out, IsJsonFileName(sharingStatsFileName), model.cores[0].cache.offsetShamt);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << sharingStatsFileName << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+
+//Prints the configurations of a sweep
+void PrintSweepConfig(const SimulationState & state)
+{
+    std::cout << "Cache Sweep Configuration\n\n";
+    std::cout << "   " << state.caches.size() << " cache configurations";
+    if (replacementPolicy != POLICY_LRU)
+        std::cout << " with " << ReplacementPolicyName(replacementPolicy) << " replacement";
+    std::cout << "\n\n\n";
+}
+
+
+
+//Prints the summary statistics of every cache in a sweep, one row per configuration
+void PrintSweepSummary(const SimulationState & state)
+{
+    std::cout << "Sweep Summary Statistics\n";
+    std::cout << "------------------------\n";
+    std::cout << " Sets Ways  Line         Hits       Misses     Accesses  Hit ratio Miss ratio\n";
+    std::cout << "----- ---- ----- ------------ ------------ ------------ ---------- ----------\n";
+    for (size_t i = 0; i < state.caches.size(); ++i)
+    {
+        const CacheModel & cache = state.caches[i];
+        float hitRatio = static_cast<float>(cache.hitCounter) / cache.refCounter;
+        float missRatio = static_cast<float>(cache.missCounter) / cache.refCounter;
+        std::cout << std::right << std::dec;
+        std::cout << std::setw(5) << cache.geometry.numSets;
+        std::cout << std::setw(5) << cache.geometry.associativityLevel;
+        std::cout << std::setw(6) << cache.geometry.lineSize;
+        std::cout << std::setw(13) << cache.hitCounter;
+        std::cout << std::setw(13) << cache.missCounter;
+        std::cout << std::setw(13) << cache.refCounter;
+        std::cout << std::fixed << std::setprecision(6);
+        std::cout << std::setw(11) << hitRatio;
+        std::cout << std::setw(11) << missRatio << "\n";
+    }
+    std::cout << "\n";
+}
+
+
+
+//Prints the set count and line size of a stack distance run
+void PrintStackDistanceConfig(const StackDistanceModel & model)
+{
+    std::cout << "Cache Configuration\n\n";
+    std::cout << "   " << model.geometry.numSets << " sets of line size " << model.geometry.lineSize << " bytes\n";
+    std::cout << "   LRU stack distance for 1 to " << model.geometry.associativityLevel << " ways\n";
+    std::cout << "\n\n";
+}
+
+
+
+//Prints the miss ratio curve of a stack distance run, one row per associativity
+void PrintStackDistanceSummary(const StackDistanceModel & model)
+{
+    std::cout << "Stack Distance Summary Statistics\n";
+    std::cout << "---------------------------------\n";
+    std::cout << " Ways   Capacity         Hits       Misses     Accesses  Hit ratio Miss ratio\n";
+    std::cout << "----- ---------- ------------ ------------ ------------ ---------- ----------\n";
+    size_t hitCounter = 0;
+    for (size_t ways = 1; ways <= model.geometry.associativityLevel; ++ways)
+    {
+        hitCounter += model.depthCounter[ways]; //a W-way cache hits every reference at depth W or less
+        size_t missCounter = model.refCounter - hitCounter;
+        float hitRatio = static_cast<float>(hitCounter) / model.refCounter;
+        float missRatio = static_cast<float>(missCounter) / model.refCounter;
+        std::cout << std::right << std::dec;
+        std::cout << std::setw(5) << ways;
+        std::cout << std::setw(11) << model.geometry.numSets * ways * model.geometry.lineSize;
+        std::cout << std::setw(13) << hitCounter;
+        std::cout << std::setw(13) << missCounter;
+        std::cout << std::setw(13) << model.refCounter;
+        std::cout << std::fixed << std::setprecision(6);
+        std::cout << std::setw(11) << hitRatio;
+        std::cout << std::setw(11) << missRatio << "\n";
+    }
+    std::cout << "\n";
+}
+
+
+
+//Expands a --sweep list into cache geometries.  Returns FALSE if the list is malformed or out of range.
+bool ParseSweepSpec(const std::string & spec, std::vector<CacheGeometry> & geometries)
+{
+    size_t entryStart = 0;
+    while (entryStart <= spec.size())
+    {
+        size_t entryEnd = spec.find(',', entryStart);
+        if (entryEnd == std::string::npos)
+            entryEnd = spec.size();
+        std::string entry = spec.substr(entryStart, entryEnd - entryStart);
+        
+        size_t firstX = entry.find('x');
+        size_t secondX = (firstX == std::string::npos) ? std::string::npos : entry.find('x', firstX + 1);
+        if (secondX == std::string::npos)
+            return false;
+        
+        std::vector<size_t> setsList, waysList, lineList;
+        if (!ParseSweepRange(entry.substr(0, firstX), true, MAX_SETS, setsList) ||
+            !ParseSweepRange(entry.substr(firstX + 1, secondX - firstX - 1), false, MAX_ASSOCIATIVITY, waysList) ||
+            !ParseSweepRange(entry.substr(secondX + 1), true, 0, lineList))
+            return false;
+        
+        for (size_t s = 0; s < setsList.size(); ++s)
+            for (size_t w = 0; w < waysList.size(); ++w)
+                for (size_t l = 0; l < lineList.size(); ++l)
+                {
+                    CacheGeometry geometry = {setsList[s], waysList[w], lineList[l]};
+                    geometries.push_back(geometry);
+                }
+        
+        entryStart = entryEnd + 1;
+    }
+    return !geometries.empty();
+}
+
+
+
+//Expands one field of a --sweep entry, either "n" or "lo-hi".  Power of two fields step by doubling and
+//must be powers of two; others step by one.  A limit of 0 means no upper limit.
+bool ParseSweepRange(const std::string & field, bool powerOfTwo, size_t limit, std::vector<size_t> & values)
+{
+    char *end;
+    size_t low = strtoul(field.c_str(), &end, 10);
+    size_t high = low;
+    if (*end == '-')
+        high = strtoul(end + 1, &end, 10);
+    if (end == field.c_str() || *end != '\0' || low < 1 || high < low || (limit != 0 && high > limit))
+        return false;
+    if (powerOfTwo && ((low & (low - 1)) != 0 || (high & (high - 1)) != 0))
+        return false;
+    
+    for (size_t value = low; value <= high; value = powerOfTwo ? value * 2 : value + 1)
+        values.push_back(value);
+    return true;
+}
+
+
+
+//Reads the --threads count.  0 stands for the number of cores.  Returns FALSE if the count is not a number.
+bool ParseThreadCount(const char *text, size_t & threads)
+{
+    char *end;
+    threads = strtoul(text, &end, 10);
+    if (end == text || *end != '\0')
+        return false;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    return true;
+}
+
+
+
+//Reads a --sample-time window:period[:warm-up] in references.  The warm-up defaults to the rest of the period, so
+//the cache is kept warm all the way between windows.  Returns FALSE if the fields do not fit in a period.
+bool ParseTimeSampleSpec(const char *text)
+{
+    char *end;
+    timeSampleWindow = strtoul(text, &end, 10);
+    if (end == text || *end != ':')
+        return false;
+    const char *periodText = end + 1;
+    timeSamplePeriod = strtoul(periodText, &end, 10);
+    if (end == periodText || timeSampleWindow == 0 || timeSamplePeriod < timeSampleWindow)
+        return false;
+    timeSampleWarmup = timeSamplePeriod - timeSampleWindow;
+    if (*end == ':')
+    {
+        const char *warmupText = end + 1;
+        timeSampleWarmup = strtoul(warmupText, &end, 10);
+        if (end == warmupText || timeSampleWarmup > timeSamplePeriod - timeSampleWindow)
+            return false;
+    }
+    return *end == '\0';
+}
+
+
+
+//Reads trace.dat file and stores it in a vector for later use
+size_t ReadDataTrace(std::vector<std::string> & traceDat)
+{
+    //NOTE - This program was developed and tested using XCode which does not directly support re-directed input
+    //Therefore a trace named with --trace is read by pointing cin at the file.
+    std::streambuf *cinBuf, *datBuf;
+    cinBuf = std::cin.rdbuf(); //backs up the std::cin buffer.
+    
+    std::ifstream inDatFile;
+    if (traceFileName != NULL)
+    {
+        inDatFile.open(traceFileName,std::ios::in);
+        if (!inDatFile)
+        {
+            std::cerr << "Failed to read data file.\n";
+            exit(EXIT_FAILURE);
+        }
+        datBuf = inDatFile.rdbuf(); //obtains buffer for inFile stream
+        std::cin.rdbuf(datBuf);   //Assign cin to the data buffer.  Now, cin will be reading from file.
+    }
+    
+    std::string inputLine;
+    numDataLines = 0;
+    
+    //continue reading until end found
+    while (std::getline(std::cin, inputLine))
+    {
+        traceDat.push_back(inputLine); //adds the line to the data vector
+        ++numDataLines;
+        
+    }
+    
+    std::cin.rdbuf(cinBuf); //restore cin to original state; has no effect when reading stdin
+    return numDataLines;
 }
 
 //dumpCache - Used for Debugging
@@ -531,37 +2724,32 @@ void DumpCache(setAssociation & cacheAssociation, size_t refCounter)
 {
     std::cout << "\n\nCache state after reference: " << refCounter << "\n";
     std::cout << "----------" << "\n";
-    for (size_t i = 0; i < numSets; ++i)
+    for (size_t i = 0; i < cacheAssociation.Sets(); ++i)
     {
         std::cout << "Index: " << i << "\n";
-        for (size_t j = 0; j < associativityLevel; ++j)
-        {
-            std::cout << "Valid Bit: " << cacheAssociation[j][i].blockData.validBit << "\t";
-        }
-        std::cout << std::flush << "\n";
-        for (size_t j = 0; j < associativityLevel; ++j)
+        for (size_t j = 0; j < cacheAssociation.Ways(); ++j)
         {
-            std::cout << "Dirty Bit: " << cacheAssociation[j][i].blockData.dirtyBit << "\t";
+            std::cout << "Valid Bit: " << cacheAssociation.IsValid(i, j) << "\t";
         }
         std::cout << std::flush << "\n";
-        for (size_t j = 0; j < associativityLevel; ++j)
+        for (size_t j = 0; j < cacheAssociation.Ways(); ++j)
         {
-            std::cout << "Tag      : " << cacheAssociation[j][i].blockData.Tag << "\t";
+            std::cout << "Dirty Bit: " << cacheAssociation.IsDirty(i, j) << "\t";
         }
         std::cout << std::flush << "\n";
-        for (size_t j = 0; j < associativityLevel; ++j)
+        for (size_t j = 0; j < cacheAssociation.Ways(); ++j)
         {
-            std::cout << "Data     : " << cacheAssociation[j][i].blockData.Data << "\t";
+            std::cout << "Tag      : " << cacheAssociation.Tag(i, j) << "\t";
         }
         std::cout << std::flush << "\n";
-        for (size_t j = 0; j < associativityLevel; ++j)
+        for (size_t j = 0; j < cacheAssociation.Ways(); ++j)
         {
-            std::cout << "Valid Bit: " << cacheAssociation[j][i].blockData.validBit << "\t";
+            std::cout << "Valid Bit: " << cacheAssociation.IsValid(i, j) << "\t";
         }
         std::cout << std::flush << "\n";
-        for (size_t j = 0; j < associativityLevel; ++j)
+        for (size_t j = 0; j < cacheAssociation.Ways(); ++j)
         {
-            std::cout << "LRU Bit  : " << cacheAssociation[j][i].blockData.LRU << "\t";
+            std::cout << "LRU Bit  : " << static_cast<unsigned int>(cacheAssociation.LRU(i, j)) << "\t";
         }
         std::cout << std::flush << "\n";
         std::cout << "\n\n";
@@ -0,0 +1,235 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Compulsory / capacity / conflict (3C) classification of the data cache's misses.
+
+ Every line access of the data cache is also run through two models:
+
+    a first-touch set of every line ever referenced; a miss on a line not in it is compulsory
+    a fully associative LRU cache with the same number of lines; a miss it also misses is a capacity miss,
+    and a miss it hits is a conflict miss that more associativity would remove
+
+ The first-touch set is a bitmap over line numbers split into pages that are allocated when first touched, so its
+ memory follows the footprint of the trace rather than its length.  The pages of the 32-bit address space are found
+ in a table, those of lines above it through a hash map.  The shadow cache keeps its lines in a doubly
+ linked recency list with a hash index, so every access is O(1).
+ */
+
+#ifndef MISSCLASSIFIER_H
+#define MISSCLASSIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+enum MissClass
+{
+    MISS_NONE, //a hit
+    MISS_COMPULSORY,
+    MISS_CAPACITY,
+    MISS_CONFLICT
+};
+
+//Set of line numbers, one bit per line, allocated a page at a time
+class FirstTouchSet
+{
+public:
+    //forgets every line; lineShift is log2 of the line size, which sets the pages of the 32-bit address space
+    void Reset(unsigned int lineShift)
+    {
+        size_t lineBits = 32 - lineShift;
+        size_t pageCount = (lineBits > PAGE_SHIFT) ? (size_t(1) << (lineBits - PAGE_SHIFT)) : 1;
+        pages.assign(pageCount, std::vector<uint64_t>());
+        highPages.clear();
+    }
+
+    //adds line; returns TRUE if it was not in the set yet
+    bool Insert(uint64_t line)
+    {
+        uint64_t pageNumber = line >> PAGE_SHIFT;
+        std::vector<uint64_t> & page = (pageNumber < pages.size()) ? pages[pageNumber] : highPages[pageNumber];
+        if (page.empty())
+            page.assign((size_t(1) << PAGE_SHIFT) / 64, 0);
+        unsigned int bit = static_cast<unsigned int>(line & ((1u << PAGE_SHIFT) - 1));
+        uint64_t mask = uint64_t(1) << (bit % 64);
+        if (page[bit / 64] & mask)
+            return false;
+        page[bit / 64] |= mask;
+        return true;
+    }
+
+private:
+    static const unsigned int PAGE_SHIFT = 16; //lines per page as a power of two, 8 KiB of bits
+
+    std::vector<std::vector<uint64_t> > pages;
+    std::unordered_map<uint64_t, std::vector<uint64_t> > highPages; //pages above the 32-bit address space
+};
+
+const size_t NO_SHADOW_SLOT = static_cast<size_t>(-1); //ends the shadow cache's recency list
+
+//Fully associative LRU cache of line numbers
+class FullyAssociativeLru
+{
+public:
+    void Resize(size_t lines)
+    {
+        capacity = lines;
+        slotLine.assign(lines, 0);
+        newer.assign(lines, NO_SHADOW_SLOT);
+        older.assign(lines, NO_SHADOW_SLOT);
+        slots.clear();
+        slots.reserve(2 * lines);
+        mostRecent = NO_SHADOW_SLOT;
+        leastRecent = NO_SHADOW_SLOT;
+        used = 0;
+    }
+
+    //Looks line up and makes it the most recently used.  On a miss the line is brought in, replacing the least
+    //recently used line, unless allocate is FALSE.  Returns TRUE for a hit.
+    bool Access(uint64_t line, bool allocate)
+    {
+        std::unordered_map<uint64_t, size_t>::iterator found = slots.find(line);
+        if (found != slots.end())
+        {
+            MoveToFront(found->second);
+            return true;
+        }
+        if (!allocate)
+            return false;
+
+        size_t slot;
+        if (used < capacity)
+            slot = used++;
+        else
+        {
+            slot = leastRecent;
+            Unlink(slot);
+            slots.erase(slotLine[slot]);
+        }
+        slotLine[slot] = line;
+        slots[line] = slot;
+        LinkAtFront(slot);
+        return false;
+    }
+
+private:
+    void Unlink(size_t slot)
+    {
+        if (newer[slot] != NO_SHADOW_SLOT)
+            older[newer[slot]] = older[slot];
+        else
+            mostRecent = older[slot];
+        if (older[slot] != NO_SHADOW_SLOT)
+            newer[older[slot]] = newer[slot];
+        else
+            leastRecent = newer[slot];
+    }
+
+    void LinkAtFront(size_t slot)
+    {
+        newer[slot] = NO_SHADOW_SLOT;
+        older[slot] = mostRecent;
+        if (mostRecent != NO_SHADOW_SLOT)
+            newer[mostRecent] = slot;
+        mostRecent = slot;
+        if (leastRecent == NO_SHADOW_SLOT)
+            leastRecent = slot;
+    }
+
+    void MoveToFront(size_t slot)
+    {
+        if (slot == mostRecent)
+            return;
+        Unlink(slot);
+        LinkAtFront(slot);
+    }
+
+    size_t capacity;
+    size_t used; //slots filled so far
+    std::vector<uint64_t> slotLine; //line held by each slot
+    std::vector<size_t> newer; //recency list, by slot
+    std::vector<size_t> older;
+    size_t mostRecent;
+    size_t leastRecent;
+    std::unordered_map<uint64_t, size_t> slots; //line -> slot
+};
+
+//Runs the first-touch set and the shadow cache beside the data cache and counts its misses by class
+class MissClassifier
+{
+public:
+    MissClassifier()
+    {
+        Configure(0, 0);
+    }
+
+    //capacityLines is the data cache's sets times ways
+    void Configure(size_t capacityLines, unsigned int lineShift)
+    {
+        firstTouch.Reset(lineShift);
+        shadow.Resize(capacityLines);
+        compulsoryCounter = 0;
+        capacityCounter = 0;
+        conflictCounter = 0;
+    }
+
+    //Classifies one line access of the data cache, which hit or missed.  allocate is FALSE for a store that does
+    //not allocate on a miss, so the shadow cache follows the same rule.
+    MissClass Classify(uint64_t line, bool hit, bool allocate)
+    {
+        bool firstUse = firstTouch.Insert(line);
+        bool shadowHit = shadow.Access(line, allocate);
+        if (hit)
+            return MISS_NONE;
+        if (firstUse)
+        {
+            ++compulsoryCounter;
+            return MISS_COMPULSORY;
+        }
+        if (!shadowHit)
+        {
+            ++capacityCounter;
+            return MISS_CAPACITY;
+        }
+        ++conflictCounter;
+        return MISS_CONFLICT;
+    }
+
+    size_t Compulsory() const
+    {
+        return compulsoryCounter;
+    }
+
+    size_t Capacity() const
+    {
+        return capacityCounter;
+    }
+
+    size_t Conflict() const
+    {
+        return conflictCounter;
+    }
+
+private:
+    FirstTouchSet firstTouch;
+    FullyAssociativeLru shadow;
+    size_t compulsoryCounter;
+    size_t capacityCounter;
+    size_t conflictCounter;
+};
+
+inline const char * MissClassName(MissClass missClass)
+{
+    switch (missClass)
+    {
+        case MISS_NONE:         return "";
+        case MISS_COMPULSORY:   return "compulsory";
+        case MISS_CAPACITY:     return "capacity";
+        case MISS_CONFLICT:     return "conflict";
+    }
+    return "unknown";
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Block buffered output for the per-reference rows.
+
+ OutputWriter is a stream buffer with a large put area.  Install() puts it under std::cout, so everything the program
+ prints still goes through one buffer in order, and std::cerr, which is tied to std::cout, flushes it before every
+ error message just as before.  The row printer skips iostream formatting altogether and writes right-aligned
+ decimal, hex and text fields straight into the buffer with the Put functions; the buffer is written out to the
+ original std::cout buffer only when it is full, when std::cout is flushed, or at exit.
+ */
+
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+
+const size_t OUTPUT_BUFFER_SIZE = 1 << 20; //bytes collected before a write
+
+class OutputWriter : public std::streambuf
+{
+public:
+    OutputWriter()
+        : buffer(OUTPUT_BUFFER_SIZE), target(NULL)
+    {
+        setp(&buffer[0], &buffer[0] + buffer.size());
+    }
+
+    //flushes and gives std::cout its own buffer back, so output written during exit still has somewhere to go
+    ~OutputWriter()
+    {
+        Remove();
+    }
+
+    //routes std::cout through this buffer
+    void Install()
+    {
+        if (target == NULL)
+            target = std::cout.rdbuf(this);
+    }
+
+    void Remove()
+    {
+        if (target != NULL)
+        {
+            sync();
+            std::cout.rdbuf(target);
+            target = NULL;
+        }
+    }
+
+    //value in decimal, right-aligned in width characters
+    void PutDecimal(size_t value, size_t width)
+    {
+        char digits[20];
+        char *first = digits + sizeof(digits);
+        do
+        {
+            *--first = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        PutField(first, digits + sizeof(digits) - first, width);
+    }
+
+    //value in lower case hex without a prefix, right-aligned in width characters
+    void PutHex(uint64_t value, size_t width)
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+        char digits[16];
+        char *first = digits + sizeof(digits);
+        do
+        {
+            *--first = hexDigits[value & 0xF];
+            value >>= 4;
+        } while (value != 0);
+        PutField(first, digits + sizeof(digits) - first, width);
+    }
+
+    //text right-aligned in width characters
+    void PutText(const char *text, size_t width)
+    {
+        PutField(text, strlen(text), width);
+    }
+
+    void PutChar(char c)
+    {
+        if (pptr() == epptr())
+            Flush();
+        *pptr() = c;
+        pbump(1);
+    }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        Flush();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual int sync()
+    {
+        Flush();
+        return target->pubsync();
+    }
+
+private:
+    //writes length characters, padded with leading spaces to width like std::setw() with std::right
+    void PutField(const char *text, size_t length, size_t width)
+    {
+        size_t padding = (length < width) ? width - length : 0;
+        if (static_cast<size_t>(epptr() - pptr()) < padding + length) //fields are a few characters, so one flush makes room
+            Flush();
+        char *out = pptr();
+        memset(out, ' ', padding);
+        memcpy(out + padding, text, length);
+        pbump(static_cast<int>(padding + length));
+    }
+
+    //hands the collected bytes to the original std::cout buffer and empties the put area
+    void Flush()
+    {
+        if (pptr() != pbase())
+            target->sputn(pbase(), pptr() - pbase());
+        setp(&buffer[0], &buffer[0] + buffer.size());
+    }
+
+    std::vector<char> buffer;
+    std::streambuf *target; //std::cout's own buffer while installed, NULL otherwise
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Hardware prefetcher models for the data cache.
+
+ A prefetcher watches the line numbers (address >> line size bits) of the data cache's demand misses, and of the
+ first use of every line it prefetched, and predicts which lines will be needed next.  It only makes predictions;
+ the simulator drops the ones already in the cache and fills the rest through the cache's own sets, ways and
+ replacement policy.
+
+    next-line   the next degree lines after the one trained on
+    stride      a table of 4 KiB regions, each remembering its last line and stride; once the same stride is seen
+                twice in a row, the next degree lines along it are predicted.  No program counter is needed.
+    stream      a few sequential streams, each started by a miss and confirmed by a miss on a neighbouring line;
+                a confirmed stream runs degree lines ahead of its last use, up or down
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+enum PrefetcherKind
+{
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE,
+    PREFETCH_STRIDE,
+    PREFETCH_STREAM
+};
+
+const size_t STRIDE_TABLE_SIZE = 64; //regions the stride prefetcher remembers
+const unsigned int STRIDE_REGION_SHIFT = 12; //log2 of the region size in bytes
+const size_t STREAM_COUNT = 4; //streams followed at once
+
+class Prefetcher
+{
+public:
+    Prefetcher()
+    {
+        Configure(PREFETCH_NONE, 1, 0);
+    }
+
+    //forgets everything learned; lineShift is log2 of the cache's line size
+    void Configure(PrefetcherKind prefetcherKind, size_t prefetchDegree, unsigned int lineShift)
+    {
+        kind = prefetcherKind;
+        degree = prefetchDegree;
+        regionShift = (lineShift < STRIDE_REGION_SHIFT) ? STRIDE_REGION_SHIFT - lineShift : 0;
+        strides.assign(STRIDE_TABLE_SIZE, StrideEntry());
+        streams.assign(STREAM_COUNT, StreamEntry());
+        clock = 0;
+    }
+
+    bool Enabled() const
+    {
+        return kind != PREFETCH_NONE;
+    }
+
+    //Trains on a line that missed or was used for the first time after a prefetch, and appends the lines to
+    //prefetch to predictions
+    void Train(uint64_t line, std::vector<uint64_t> & predictions)
+    {
+        switch (kind)
+        {
+            case PREFETCH_NONE:
+                break;
+            case PREFETCH_NEXT_LINE:
+                for (size_t i = 1; i <= degree; ++i)
+                    predictions.push_back(line + i);
+                break;
+            case PREFETCH_STRIDE:
+                TrainStride(line, predictions);
+                break;
+            case PREFETCH_STREAM:
+                TrainStream(line, predictions);
+                break;
+        }
+    }
+
+private:
+    struct StrideEntry
+    {
+        StrideEntry() : valid(false), region(0), lastLine(0), stride(0), confirmed(false) {}
+        bool valid;
+        uint64_t region;
+        uint64_t lastLine;
+        int stride; //in lines
+        bool confirmed; //the last two strides were equal
+    };
+
+    struct StreamEntry
+    {
+        StreamEntry() : valid(false), lastLine(0), direction(0), lastUse(0) {}
+        bool valid;
+        uint64_t lastLine;
+        int direction; //+1 or -1 once confirmed, 0 while waiting for a second miss
+        size_t lastUse;
+    };
+
+    void TrainStride(uint64_t line, std::vector<uint64_t> & predictions)
+    {
+        uint64_t region = line >> regionShift;
+        StrideEntry & entry = strides[region % STRIDE_TABLE_SIZE];
+        if (!entry.valid || entry.region != region) //a new region replaces whatever shared its slot
+        {
+            entry.valid = true;
+            entry.region = region;
+            entry.lastLine = line;
+            entry.stride = 0;
+            entry.confirmed = false;
+            return;
+        }
+
+        int stride = static_cast<int>(line - entry.lastLine);
+        if (stride == 0)
+            return;
+        entry.confirmed = (stride == entry.stride);
+        entry.stride = stride;
+        entry.lastLine = line;
+        if (entry.confirmed)
+        {
+            for (size_t i = 1; i <= degree; ++i)
+            {
+                int64_t offset = int64_t(stride) * int64_t(i);
+                if (offset < 0 && uint64_t(-offset) > line)
+                    break; //a descending stride stops at line 0 instead of wrapping around
+                predictions.push_back(line + uint64_t(offset));
+            }
+        }
+    }
+
+    void TrainStream(uint64_t line, std::vector<uint64_t> & predictions)
+    {
+        ++clock;
+        size_t replace = 0;
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            StreamEntry & stream = streams[i];
+            if (!stream.valid)
+            {
+                replace = i;
+                continue;
+            }
+            if (streams[replace].valid && stream.lastUse < streams[replace].lastUse)
+                replace = i;
+
+            int distance = static_cast<int>(line - stream.lastLine);
+            if (stream.direction == 0 && (distance == 1 || distance == -1))
+                stream.direction = distance; //the second miss sets the direction
+            else if (stream.direction == 0 || distance * stream.direction < 1 ||
+                     distance * stream.direction > static_cast<int>(degree))
+                continue;
+
+            stream.lastLine = line;
+            stream.lastUse = clock;
+            for (size_t ahead = 1; ahead <= degree; ++ahead)
+            {
+                if (stream.direction < 0 && ahead > line)
+                    break; //a descending stream stops at line 0 instead of wrapping around
+                predictions.push_back(line + uint64_t(int64_t(stream.direction) * int64_t(ahead)));
+            }
+            return;
+        }
+
+        //no stream expected this line, so it may start one in place of the least recently used
+        streams[replace].valid = true;
+        streams[replace].lastLine = line;
+        streams[replace].direction = 0;
+        streams[replace].lastUse = clock;
+    }
+
+    PrefetcherKind kind;
+    size_t degree; //lines predicted per training event
+    unsigned int regionShift; //log2 of the lines per stride region
+    std::vector<StrideEntry> strides;
+    std::vector<StreamEntry> streams;
+    size_t clock; //training events seen, for the stream LRU
+};
+
+//Converts a prefetcher name from trace.config.  Returns FALSE if the name is not known.
+inline bool ParsePrefetcherKind(const std::string & name, PrefetcherKind & kind)
+{
+    const char *value = name.c_str();
+    if (strcasecmp(value, "none") == 0)
+        kind = PREFETCH_NONE;
+    else if (strcasecmp(value, "next-line") == 0 || strcasecmp(value, "next-N-line") == 0)
+        kind = PREFETCH_NEXT_LINE;
+    else if (strcasecmp(value, "stride") == 0)
+        kind = PREFETCH_STRIDE;
+    else if (strcasecmp(value, "stream") == 0)
+        kind = PREFETCH_STREAM;
+    else
+        return false;
+    return true;
+}
+
+inline const char * PrefetcherKindName(PrefetcherKind kind)
+{
+    switch (kind)
+    {
+        case PREFETCH_NONE:         return "no";
+        case PREFETCH_NEXT_LINE:    return "next-line";
+        case PREFETCH_STRIDE:       return "stride";
+        case PREFETCH_STREAM:       return "stream";
+    }
+    return "unknown";
+}
+
+#endif
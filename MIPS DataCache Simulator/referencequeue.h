@@ -0,0 +1,113 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Lock-free broadcast queue that carries decoded references from the trace reader to the sweep worker threads.
+
+ There is one producer (the thread reading the trace) and a fixed number of consumers (the workers).  The
+ producer fills batches of validated references in a ring of REFERENCE_QUEUE_SLOTS slots; every consumer reads
+ every batch, in order, and the slot is reused only after all of them have moved past it.  Batches are never
+ modified once published, so the workers share them read-only.  Coordination uses one atomic counter for the
+ producer and one per consumer, each on its own cache line; waiting threads spin and yield.
+ */
+
+#ifndef REFERENCEQUEUE_H
+#define REFERENCEQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "traceparser.h"
+
+const size_t REFERENCE_BATCH_SIZE = 1 << 14; //references per batch
+const size_t REFERENCE_QUEUE_SLOTS = 16; //batches in flight; bounds the memory used between reader and workers
+
+struct ReferenceBatch
+{
+    size_t count;
+    TraceFields refs[REFERENCE_BATCH_SIZE];
+};
+
+class ReferenceBroadcastQueue
+{
+public:
+    ReferenceBroadcastQueue(size_t consumers)
+        : slots(REFERENCE_QUEUE_SLOTS), consumed(consumers)
+    {
+        published.store(0);
+        closed.store(false);
+        for (size_t i = 0; i < consumed.size(); ++i)
+            consumed[i].value.store(0);
+    }
+
+    //returns the next batch to fill, waiting until every consumer is done with its previous contents
+    ReferenceBatch & ProducerSlot()
+    {
+        uint64_t next = published.load(std::memory_order_relaxed);
+        while (next - SlowestConsumer() >= REFERENCE_QUEUE_SLOTS)
+            std::this_thread::yield();
+        ReferenceBatch & batch = slots[next % REFERENCE_QUEUE_SLOTS];
+        batch.count = 0;
+        return batch;
+    }
+
+    //makes the batch returned by ProducerSlot() visible to the consumers
+    void Publish()
+    {
+        published.fetch_add(1, std::memory_order_release);
+    }
+
+    //tells the consumers that no more batches will be published
+    void Close()
+    {
+        closed.store(true, std::memory_order_release);
+    }
+
+    //returns the next batch for a consumer, or NULL once the queue is closed and drained
+    const ReferenceBatch * Acquire(size_t consumer)
+    {
+        uint64_t next = consumed[consumer].value.load(std::memory_order_relaxed);
+        while (published.load(std::memory_order_acquire) <= next)
+        {
+            if (closed.load(std::memory_order_acquire) && published.load(std::memory_order_acquire) <= next)
+                return NULL;
+            std::this_thread::yield();
+        }
+        return &slots[next % REFERENCE_QUEUE_SLOTS];
+    }
+
+    //a consumer is finished with the batch returned by Acquire()
+    void Release(size_t consumer)
+    {
+        consumed[consumer].value.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    uint64_t SlowestConsumer() const
+    {
+        uint64_t slowest = UINT64_MAX;
+        for (size_t i = 0; i < consumed.size(); ++i)
+        {
+            uint64_t position = consumed[i].value.load(std::memory_order_acquire);
+            if (position < slowest)
+                slowest = position;
+        }
+        return slowest;
+    }
+
+    //a counter alone on its cache line, so consumers do not slow each other down
+    struct alignas(64) PaddedCounter
+    {
+        std::atomic<uint64_t> value;
+    };
+
+    std::vector<ReferenceBatch> slots;
+    std::vector<PaddedCounter> consumed;
+    alignas(64) std::atomic<uint64_t> published;
+    std::atomic<bool> closed;
+};
+
+#endif
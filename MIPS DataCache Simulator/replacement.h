@@ -0,0 +1,396 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Replacement policies.
+
+ Every policy is a class with four static functions that the simulator calls for one set:
+
+    OnHit(cache, set, way)          the reference hit way
+    Victim(cache, set)              returns the way to overwrite on a miss
+    OnFill(cache, set, way)         a new line was just written into way
+    OnInvalidate(cache, set, way)   the line in way was dropped (by a cache hierarchy); it should be replaced first
+
+ The simulator is a template over the policy class and is instantiated once per policy, so the per-reference
+ path calls these directly with no virtual dispatch.  Per-way state lives in CacheStorage::WayState() (the LRU
+ counters for LRU) and per-set state in CacheStorage::SetState().  The functions are also templates over the
+ storage type, so the same code runs on a CacheStorage or on a CacheStorageView whose number of ways is a compile
+ time constant, where the loops over the ways unroll.
+ */
+
+#ifndef REPLACEMENT_H
+#define REPLACEMENT_H
+
+#include <stddef.h>
+#include <string>
+#include <strings.h>
+
+#include "cachestorage.h"
+
+enum ReplacementPolicy
+{
+    POLICY_LRU,
+    POLICY_TREE_PLRU,
+    POLICY_NRU,
+    POLICY_FIFO,
+    POLICY_RANDOM,
+    POLICY_SRRIP,
+    POLICY_BRRIP
+};
+
+//returns the way of the lowest set bit in mask
+inline size_t LowestWay(unsigned int mask)
+{
+    return static_cast<size_t>(__builtin_ctz(mask));
+}
+
+//returns a mask with one bit per way of the cache
+template <class Cache>
+unsigned int AllWaysMask(const Cache & cache)
+{
+    return (1u << cache.Ways()) - 1;
+}
+
+
+//True LRU with one counter per way: the most recently used way holds ways-1 and the victim is the first way
+//holding 0.  This is the original simulator's policy, kept step for step so its output does not change.
+struct LruPolicy
+{
+    template <class Cache>
+    static void OnHit(Cache & cache, size_t set, size_t way)
+    {
+        size_t mostRecent = cache.Ways() - 1;
+        if (cache.LRU(set, way) != mostRecent) //if the LRU bit is not the highest
+        {
+            unsigned int LRU_Test = cache.LRU(set, way); //get current LRU value
+            for (size_t i = 0; i < cache.Ways(); ++i) //subtract 1 from LRUs that are greater than LRU_Test
+            {
+                if (cache.LRU(set, i) > LRU_Test)
+                    --(cache.LRU(set, i));
+            }
+            cache.LRU(set, way) = mostRecent; //now, set LRU of hit block to highest
+        }
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        size_t indexToUse = 0; //Assume we start with 0.
+        for (size_t i = 0; i < cache.Ways(); ++i)
+        {
+            if (cache.LRU(set, i) == 0)
+            {
+                indexToUse = i;
+                break;  //once 0 is found, break out of loop.
+            }
+        }
+        return indexToUse;
+    }
+
+    template <class Cache>
+    static void OnFill(Cache & cache, size_t set, size_t way)
+    {
+        for (size_t i = 0; i < cache.Ways(); ++i)
+        {
+            if (cache.LRU(set, i) > 0) //if the LRU bit is greater than 0
+                --(cache.LRU(set, i)); //subract 1.
+        }
+        cache.LRU(set, way) = cache.Ways() - 1; //set max val to associativity level
+    }
+
+    template <class Cache>
+    static void OnInvalidate(Cache & cache, size_t set, size_t way)
+    {
+        unsigned int LRU_Test = cache.LRU(set, way);
+        for (size_t i = 0; i < cache.Ways(); ++i) //add 1 to LRUs that are less than LRU_Test
+        {
+            if (cache.LRU(set, i) < LRU_Test)
+                ++(cache.LRU(set, i));
+        }
+        cache.LRU(set, way) = 0; //the dropped block is now the least recently used
+    }
+};
+
+
+//Tree pseudo-LRU.  The ways are the leaves of a binary tree whose internal nodes are numbered 1 to ways-1 and
+//stored as bits of SetState(); a 0 bit points the victim search left, a 1 bit right.  Every access flips the
+//nodes on its path to point away from it.  Needs a power-of-two number of ways.
+struct TreePlruPolicy
+{
+    template <class Cache>
+    static void Touch(Cache & cache, size_t set, size_t way)
+    {
+        unsigned char & bits = cache.SetState(set);
+        for (size_t node = way + cache.Ways(); node > 1; node >>= 1)
+        {
+            unsigned char parentBit = static_cast<unsigned char>(1 << (node >> 1));
+            if (node & 1) //right child, point the parent left
+                bits &= static_cast<unsigned char>(~parentBit);
+            else
+                bits |= parentBit;
+        }
+    }
+
+    template <class Cache>
+    static void OnHit(Cache & cache, size_t set, size_t way)
+    {
+        Touch(cache, set, way);
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        unsigned char bits = cache.SetState(set);
+        size_t node = 1;
+        while (node < cache.Ways())
+            node = 2 * node + ((bits >> node) & 1);
+        return node - cache.Ways();
+    }
+
+    template <class Cache>
+    static void OnFill(Cache & cache, size_t set, size_t way)
+    {
+        Touch(cache, set, way);
+    }
+
+    //points every node on the way's path towards it
+    template <class Cache>
+    static void OnInvalidate(Cache & cache, size_t set, size_t way)
+    {
+        unsigned char & bits = cache.SetState(set);
+        for (size_t node = way + cache.Ways(); node > 1; node >>= 1)
+        {
+            unsigned char parentBit = static_cast<unsigned char>(1 << (node >> 1));
+            if (node & 1)
+                bits |= parentBit;
+            else
+                bits &= static_cast<unsigned char>(~parentBit);
+        }
+    }
+};
+
+
+//Bit pseudo-LRU, also known as NRU.  Each way has a reference bit in SetState() that is set on access; when the
+//last clear bit would be set, all other bits are cleared.  The victim is the first way with a clear bit.
+struct NruPolicy
+{
+    template <class Cache>
+    static void Touch(Cache & cache, size_t set, size_t way)
+    {
+        unsigned char & bits = cache.SetState(set);
+        bits |= static_cast<unsigned char>(1 << way);
+        if (bits == AllWaysMask(cache))
+            bits = static_cast<unsigned char>(1 << way);
+    }
+
+    template <class Cache>
+    static void OnHit(Cache & cache, size_t set, size_t way)
+    {
+        Touch(cache, set, way);
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        unsigned int unreferenced = ~cache.SetState(set) & AllWaysMask(cache);
+        return (unreferenced != 0) ? LowestWay(unreferenced) : 0; //a single way is always referenced
+    }
+
+    template <class Cache>
+    static void OnFill(Cache & cache, size_t set, size_t way)
+    {
+        Touch(cache, set, way);
+    }
+
+    template <class Cache>
+    static void OnInvalidate(Cache & cache, size_t set, size_t way)
+    {
+        cache.SetState(set) &= static_cast<unsigned char>(~(1 << way));
+    }
+};
+
+
+//First in, first out.  SetState() is the next way to fill, so lines leave in the order they arrived and hits
+//do not matter.
+struct FifoPolicy
+{
+    template <class Cache>
+    static void OnHit(Cache &, size_t, size_t)
+    {
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        return cache.SetState(set);
+    }
+
+    template <class Cache>
+    static void OnFill(Cache & cache, size_t set, size_t way)
+    {
+        cache.SetState(set) = static_cast<unsigned char>((way + 1) % cache.Ways());
+    }
+
+    //the arrival order is kept, a dropped line's way is reused when its turn comes
+    template <class Cache>
+    static void OnInvalidate(Cache &, size_t, size_t)
+    {
+    }
+};
+
+
+//Random replacement.  Empty ways, including dropped ones, are filled first; after that the victim comes from the cache's own generator,
+//so a run is repeatable.
+struct RandomPolicy
+{
+    template <class Cache>
+    static void OnHit(Cache &, size_t, size_t)
+    {
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        unsigned int invalidWays = ~cache.ValidMask(set) & AllWaysMask(cache);
+        if (invalidWays != 0)
+            return LowestWay(invalidWays);
+        return cache.NextRandom() % cache.Ways();
+    }
+
+    template <class Cache>
+    static void OnFill(Cache &, size_t, size_t)
+    {
+    }
+
+    template <class Cache>
+    static void OnInvalidate(Cache &, size_t, size_t)
+    {
+    }
+};
+
+
+//Static re-reference interval prediction with 2-bit values in WayState().  A hit predicts a near re-reference
+//(0), a fill a long one (RRIP_LONG).  The victim is the first way predicted distant (RRIP_DISTANT); if there is
+//none, every way is aged by one and the search repeats.
+const unsigned char RRIP_DISTANT = 3;
+const unsigned char RRIP_LONG = 2;
+
+template <class Cache>
+size_t RripVictim(Cache & cache, size_t set)
+{
+    unsigned int invalidWays = ~cache.ValidMask(set) & AllWaysMask(cache);
+    if (invalidWays != 0)
+        return LowestWay(invalidWays);
+
+    while (true)
+    {
+        for (size_t i = 0; i < cache.Ways(); ++i)
+        {
+            if (cache.WayState(set, i) == RRIP_DISTANT)
+                return i;
+        }
+        for (size_t i = 0; i < cache.Ways(); ++i)
+            ++cache.WayState(set, i);
+    }
+}
+
+struct SrripPolicy
+{
+    template <class Cache>
+    static void OnHit(Cache & cache, size_t set, size_t way)
+    {
+        cache.WayState(set, way) = 0;
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        return RripVictim(cache, set);
+    }
+
+    template <class Cache>
+    static void OnFill(Cache & cache, size_t set, size_t way)
+    {
+        cache.WayState(set, way) = RRIP_LONG;
+    }
+
+    template <class Cache>
+    static void OnInvalidate(Cache &, size_t, size_t)
+    {
+    }
+};
+
+
+//Bimodal RRIP: like SRRIP, but most fills are predicted distant and only one in BRRIP_LONG_CHANCE is inserted
+//long, which keeps scanning and thrashing patterns from flushing the cache.
+const unsigned int BRRIP_LONG_CHANCE = 32;
+
+struct BrripPolicy
+{
+    template <class Cache>
+    static void OnHit(Cache & cache, size_t set, size_t way)
+    {
+        cache.WayState(set, way) = 0;
+    }
+
+    template <class Cache>
+    static size_t Victim(Cache & cache, size_t set)
+    {
+        return RripVictim(cache, set);
+    }
+
+    template <class Cache>
+    static void OnFill(Cache & cache, size_t set, size_t way)
+    {
+        if (cache.NextRandom() % BRRIP_LONG_CHANCE == 0)
+            cache.WayState(set, way) = RRIP_LONG;
+        else
+            cache.WayState(set, way) = RRIP_DISTANT;
+    }
+
+    template <class Cache>
+    static void OnInvalidate(Cache &, size_t, size_t)
+    {
+    }
+};
+
+
+//Converts a policy name from trace.config.  Returns FALSE if the name is not known.
+inline bool ParseReplacementPolicy(const std::string & name, ReplacementPolicy & policy)
+{
+    const char *value = name.c_str();
+    if (strcasecmp(value, "LRU") == 0)
+        policy = POLICY_LRU;
+    else if (strcasecmp(value, "PLRU") == 0 || strcasecmp(value, "tree-PLRU") == 0)
+        policy = POLICY_TREE_PLRU;
+    else if (strcasecmp(value, "NRU") == 0 || strcasecmp(value, "bit-PLRU") == 0)
+        policy = POLICY_NRU;
+    else if (strcasecmp(value, "FIFO") == 0)
+        policy = POLICY_FIFO;
+    else if (strcasecmp(value, "random") == 0)
+        policy = POLICY_RANDOM;
+    else if (strcasecmp(value, "SRRIP") == 0)
+        policy = POLICY_SRRIP;
+    else if (strcasecmp(value, "BRRIP") == 0)
+        policy = POLICY_BRRIP;
+    else
+        return false;
+    return true;
+}
+
+inline const char * ReplacementPolicyName(ReplacementPolicy policy)
+{
+    switch (policy)
+    {
+        case POLICY_LRU:        return "LRU";
+        case POLICY_TREE_PLRU:  return "tree-PLRU";
+        case POLICY_NRU:        return "NRU";
+        case POLICY_FIFO:       return "FIFO";
+        case POLICY_RANDOM:     return "random";
+        case POLICY_SRRIP:      return "SRRIP";
+        case POLICY_BRRIP:      return "BRRIP";
+    }
+    return "unknown";
+}
+
+#endif
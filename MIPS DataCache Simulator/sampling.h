@@ -0,0 +1,254 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Sampled simulation of the data cache, with confidence intervals for the extrapolated hit and miss ratios.
+
+    set sampling    a fixed, pseudo-randomly chosen subset of the sets is simulated.  Accesses to other sets are
+                    counted and dropped before any tag is compared, so the run costs about the sampled fraction of a
+                    full one.  Each sampled set is one sample.
+    time sampling   the trace is cut into periods; the last references of each period form a measured window, and
+                    the references just before it warm the cache up without being counted.  The rest of the period
+                    is passed over.  Each window is one sample.
+
+ The miss ratio is estimated as total sampled misses over total sampled accesses (a ratio estimator over the
+ samples), and its 95% confidence interval comes from the spread of the samples' misses around that ratio, with a
+ finite population correction for the fraction of sets or windows that were simulated.
+ */
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+//Accesses and misses of one set or window that was simulated
+struct SampleCounts
+{
+    uint64_t accesses;
+    uint64_t misses;
+};
+
+//Ratio estimate of the miss ratio from a list of samples
+struct SampleEstimate
+{
+    double missRatio;
+    double halfWidth; //of the 95% confidence interval; negative if there are too few samples for one
+};
+
+//Estimates the miss ratio from samples drawn out of populationSize equal units (sets or windows)
+inline SampleEstimate EstimateMissRatio(const std::vector<SampleCounts> & samples, double populationSize)
+{
+    SampleEstimate estimate = {0.0, -1.0};
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        accesses += samples[i].accesses;
+        misses += samples[i].misses;
+    }
+    if (accesses == 0)
+        return estimate;
+    estimate.missRatio = static_cast<double>(misses) / accesses;
+
+    size_t n = samples.size();
+    if (n < 2)
+        return estimate;
+    double spread = 0.0; //squared residuals of each sample's misses around the ratio
+    for (size_t i = 0; i < n; ++i)
+    {
+        double residual = samples[i].misses - estimate.missRatio * samples[i].accesses;
+        spread += residual * residual;
+    }
+    double meanAccesses = static_cast<double>(accesses) / n;
+    double sampledFraction = std::min(1.0, n / populationSize);
+    double variance = (1.0 - sampledFraction) * (spread / (n - 1)) / (n * meanAccesses * meanAccesses);
+    estimate.halfWidth = 1.96 * sqrt(variance);
+    return estimate;
+}
+
+//What time sampling does with one reference
+enum SamplePhase
+{
+    SAMPLE_SKIP, //between windows: not simulated
+    SAMPLE_WARM, //simulated to warm the cache, not counted
+    SAMPLE_MEASURE //simulated and counted
+};
+
+class Sampler
+{
+public:
+    Sampler()
+        : sampledSetCount(0), window(0), period(0), warmup(0), windowOpen(false), measuredReferences(0),
+          skippedAccesses(0)
+    {
+    }
+
+    //Simulates about one set in ratio, at least one.  The sets are picked by a fixed-seed shuffle, so a run is
+    //repeatable and sets that a stride would hit together are not picked together.
+    void ConfigureSets(size_t sets, size_t ratio)
+    {
+        std::vector<size_t> order(sets);
+        for (size_t set = 0; set < sets; ++set)
+            order[set] = set;
+        unsigned int randomState = 0x2545F491; //xorshift, as the caches use
+        for (size_t i = sets; i > 1; --i)
+        {
+            randomState ^= randomState << 13;
+            randomState ^= randomState >> 17;
+            randomState ^= randomState << 5;
+            std::swap(order[i - 1], order[randomState % i]);
+        }
+
+        size_t chosen = std::max<size_t>(1, sets / ratio);
+        sampledSets.assign(sets, 0);
+        setSamples.assign(sets, SampleCounts());
+        for (size_t i = 0; i < chosen; ++i)
+            sampledSets[order[i]] = 1;
+        sampledSetCount = chosen;
+    }
+
+    //Measures windowLength references at the end of every periodLength, after warmupLength references that only
+    //warm the cache
+    void ConfigureTime(size_t windowLength, size_t periodLength, size_t warmupLength)
+    {
+        window = windowLength;
+        period = periodLength;
+        warmup = warmupLength;
+    }
+
+    bool SamplesSets() const
+    {
+        return !sampledSets.empty();
+    }
+
+    bool SamplesTime() const
+    {
+        return period != 0;
+    }
+
+    bool SetSampled(unsigned int set) const
+    {
+        return sampledSets[set] != 0;
+    }
+
+    //an access to a set that is not sampled
+    void SkipAccess()
+    {
+        ++skippedAccesses;
+    }
+
+    void RecordSetAccess(unsigned int set, bool hit)
+    {
+        ++setSamples[set].accesses;
+        setSamples[set].misses += !hit;
+    }
+
+    //returns what to do with the reference at position, counting the first reference of the trace as 1
+    SamplePhase Phase(size_t position) const
+    {
+        size_t offset = (position - 1) % period;
+        if (offset >= period - window)
+            return SAMPLE_MEASURE;
+        if (offset >= period - window - warmup)
+            return SAMPLE_WARM;
+        return SAMPLE_SKIP;
+    }
+
+    //Called before every measured reference with the data cache's counters.  The counters at the start of a
+    //window are kept, so the window's own accesses and misses are the difference when it closes.
+    void MeasureReference(size_t accesses, size_t misses)
+    {
+        if (!windowOpen)
+        {
+            windowOpen = true;
+            windowStart.accesses = accesses;
+            windowStart.misses = misses;
+        }
+        ++measuredReferences;
+    }
+
+    //Called after a measured reference at position with the data cache's counters; closes the window after its
+    //last reference
+    void EndReference(size_t position, size_t accesses, size_t misses)
+    {
+        if ((position - 1) % period == period - 1)
+            CloseWindow(accesses, misses);
+    }
+
+    //closes a window the end of the trace cut short
+    void Finish(size_t accesses, size_t misses)
+    {
+        if (windowOpen)
+            CloseWindow(accesses, misses);
+    }
+
+    //set sampling: the counts of every sampled set; time sampling: the counts of every window
+    std::vector<SampleCounts> Samples() const
+    {
+        if (!SamplesSets())
+            return windowSamples;
+        std::vector<SampleCounts> samples;
+        for (size_t set = 0; set < sampledSets.size(); ++set)
+        {
+            if (sampledSets[set])
+                samples.push_back(setSamples[set]);
+        }
+        return samples;
+    }
+
+    size_t SampledSetCount() const
+    {
+        return sampledSetCount;
+    }
+
+    size_t Window() const
+    {
+        return window;
+    }
+
+    size_t Period() const
+    {
+        return period;
+    }
+
+    size_t Warmup() const
+    {
+        return warmup;
+    }
+
+    size_t MeasuredReferences() const
+    {
+        return measuredReferences;
+    }
+
+    size_t SkippedAccesses() const
+    {
+        return skippedAccesses;
+    }
+
+private:
+    void CloseWindow(size_t accesses, size_t misses)
+    {
+        SampleCounts sample = {accesses - windowStart.accesses, misses - windowStart.misses};
+        windowSamples.push_back(sample);
+        windowOpen = false;
+    }
+
+    std::vector<unsigned char> sampledSets; //1 for a simulated set; empty unless sets are sampled
+    std::vector<SampleCounts> setSamples;
+    size_t sampledSetCount;
+    size_t window;
+    size_t period; //0 unless time is sampled
+    size_t warmup;
+    bool windowOpen;
+    SampleCounts windowStart; //data cache counters when the open window started
+    std::vector<SampleCounts> windowSamples;
+    size_t measuredReferences;
+    size_t skippedAccesses;
+};
+
+#endif
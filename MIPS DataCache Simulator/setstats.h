@@ -0,0 +1,180 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Per-set counters and interval samples of the data cache, written out at the end of a run.
+
+ Every data cache access adds to the counters of its set: accesses, misses, lines evicted and dirty lines evicted
+ (lines replaced by prefetches count too).  A set with far more misses than its neighbours points at addresses that
+ conflict in the index bits.  Optionally the accesses are also cut into intervals of a fixed number of accesses,
+ and the misses of each interval are kept, which shows how the miss ratio moves through the trace.
+
+ Both tables are written as CSV, or as JSON when the file name ends in ".json".  Recording an access is a few
+ additions into a 32 byte entry of the set, so the counters cost next to nothing next to the simulation itself.
+ */
+
+#ifndef SETSTATS_H
+#define SETSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+class SetStatistics
+{
+public:
+    SetStatistics()
+    {
+        Configure(0, 0);
+    }
+
+    //clears every counter; intervalLength is the accesses per interval sample, 0 for no samples
+    void Configure(size_t sets, size_t intervalLength)
+    {
+        setCounters.assign(sets, SetCounters());
+        interval = intervalLength;
+        samples.clear();
+        intervalAccesses = 0;
+        intervalMisses = 0;
+        totalAccesses = 0;
+    }
+
+    //counts one access of set
+    void RecordAccess(unsigned int set, bool hit, bool evicted, bool evictedDirty)
+    {
+        SetCounters & counters = setCounters[set];
+        ++counters.accesses;
+        counters.misses += !hit;
+        counters.evictions += evicted;
+        counters.dirtyEvictions += evictedDirty;
+        if (interval == 0)
+            return;
+        ++totalAccesses;
+        ++intervalAccesses;
+        intervalMisses += !hit;
+        if (intervalAccesses == interval)
+            CloseInterval();
+    }
+
+    //counts a line of set replaced by something other than an access, such as a prefetch
+    void RecordEviction(unsigned int set, bool dirty)
+    {
+        ++setCounters[set].evictions;
+        setCounters[set].dirtyEvictions += dirty;
+    }
+
+    //dirty lines evicted from every set, which are the lines the cache wrote back
+    uint64_t DirtyEvictions() const
+    {
+        uint64_t total = 0;
+        for (size_t set = 0; set < setCounters.size(); ++set)
+            total += setCounters[set].dirtyEvictions;
+        return total;
+    }
+
+    //ends the run; a last interval shorter than the rest is kept
+    void Finish()
+    {
+        if (intervalAccesses > 0)
+            CloseInterval();
+    }
+
+    void WriteSets(std::ostream & out, bool json) const
+    {
+        if (json)
+        {
+            out << "{\n  \"sets\": [\n";
+            for (size_t set = 0; set < setCounters.size(); ++set)
+            {
+                const SetCounters & counters = setCounters[set];
+                out << "    {\"set\": " << set << ", \"accesses\": " << counters.accesses << ", \"misses\": " <<
+                    counters.misses << ", \"evictions\": " << counters.evictions << ", \"dirtyEvictions\": " <<
+                    counters.dirtyEvictions << "}" << ((set + 1 < setCounters.size()) ? ",\n" : "\n");
+            }
+            out << "  ]\n}\n";
+            return;
+        }
+
+        out << "set,accesses,misses,evictions,dirty_evictions,miss_ratio\n";
+        for (size_t set = 0; set < setCounters.size(); ++set)
+        {
+            const SetCounters & counters = setCounters[set];
+            out << set << "," << counters.accesses << "," << counters.misses << "," << counters.evictions << "," <<
+                counters.dirtyEvictions << "," << std::fixed << std::setprecision(6) <<
+                Ratio(counters.misses, counters.accesses) << "\n";
+        }
+    }
+
+    void WriteIntervals(std::ostream & out, bool json) const
+    {
+        if (json)
+        {
+            out << "{\n  \"interval\": " << interval << ",\n  \"samples\": [\n";
+            for (size_t i = 0; i < samples.size(); ++i)
+            {
+                out << "    {\"lastAccess\": " << samples[i].lastAccess << ", \"accesses\": " << samples[i].accesses <<
+                    ", \"misses\": " << samples[i].misses << ", \"missRatio\": " << std::fixed << std::setprecision(6) <<
+                    Ratio(samples[i].misses, samples[i].accesses) << "}" << ((i + 1 < samples.size()) ? ",\n" : "\n");
+            }
+            out << "  ]\n}\n";
+            return;
+        }
+
+        out << "last_access,accesses,misses,miss_ratio\n";
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            out << samples[i].lastAccess << "," << samples[i].accesses << "," << samples[i].misses << "," <<
+                std::fixed << std::setprecision(6) << Ratio(samples[i].misses, samples[i].accesses) << "\n";
+        }
+    }
+
+private:
+    struct SetCounters
+    {
+        SetCounters() : accesses(0), misses(0), evictions(0), dirtyEvictions(0) {}
+        uint64_t accesses;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t dirtyEvictions;
+    };
+
+    struct IntervalSample
+    {
+        uint64_t lastAccess; //accesses from the start of the trace to the end of the interval
+        uint64_t accesses;
+        uint64_t misses;
+    };
+
+    void CloseInterval()
+    {
+        IntervalSample sample = {totalAccesses, intervalAccesses, intervalMisses};
+        samples.push_back(sample);
+        intervalAccesses = 0;
+        intervalMisses = 0;
+    }
+
+    static double Ratio(uint64_t part, uint64_t whole)
+    {
+        return (whole != 0) ? static_cast<double>(part) / whole : 0.0;
+    }
+
+    std::vector<SetCounters> setCounters;
+    size_t interval;
+    std::vector<IntervalSample> samples;
+    uint64_t intervalAccesses; //in the interval still open
+    uint64_t intervalMisses;
+    uint64_t totalAccesses;
+};
+
+//Returns TRUE if a statistics file should be written as JSON rather than CSV
+inline bool IsJsonFileName(const char *fileName)
+{
+    size_t length = strlen(fileName);
+    return length >= 5 && strcasecmp(fileName + length - 5, ".json") == 0;
+}
+
+#endif
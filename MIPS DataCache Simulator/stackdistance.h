@@ -0,0 +1,106 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ LRU stack distance (Mattson) model.
+
+ LRU is a stack algorithm: a W-way LRU set holds exactly the W most recently used distinct lines of that set, so a
+ reference hits in every cache of W or more ways when its line is at depth W or less of the set's recency stack.
+ One pass that records the depth of every reference therefore gives the hits of every associativity at once.
+
+ The depth of a line is one plus the number of distinct lines its set used since the line's previous use.  Each set
+ numbers its accesses and keeps a Fenwick tree with a 1 at the last access of every line it holds, so the depth is
+ a prefix sum and moving a line to the top is two point updates, both O(log n).  When the numbering reaches the end
+ of the tree, the live lines are renumbered in order into a tree twice their count, which keeps the memory
+ proportional to the lines in the set and the cost amortised O(log n).
+ */
+
+#ifndef STACKDISTANCE_H
+#define STACKDISTANCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//Recency stack of one set
+class StackDistanceSet
+{
+public:
+    StackDistanceSet()
+    {
+        nextTime = 1;
+        tree.assign(MIN_TREE_SIZE + 1, 0);
+    }
+
+    //Moves tag to the top of the stack.  Returns its depth before the access (1 = most recently used), or 0 if
+    //the set has never seen it.
+    size_t Access(uint64_t tag)
+    {
+        if (nextTime == tree.size())
+            Compact();
+
+        size_t depth = 0;
+        std::unordered_map<uint64_t, size_t>::iterator line = lastUse.find(tag);
+        if (line != lastUse.end())
+        {
+            depth = lastUse.size() - PrefixSum(line->second) + 1; //lines used after it, plus itself
+            Add(line->second, -1);
+            line->second = nextTime;
+        }
+        else
+            lastUse[tag] = nextTime;
+        Add(nextTime, 1);
+        ++nextTime;
+        return depth;
+    }
+
+private:
+    static constexpr size_t MIN_TREE_SIZE = 16;
+
+    void Add(size_t position, int delta)
+    {
+        for (; position < tree.size(); position += position & (0 - position))
+            tree[position] += delta;
+    }
+
+    size_t PrefixSum(size_t position) const
+    {
+        size_t sum = 0;
+        for (; position > 0; position -= position & (0 - position))
+            sum += tree[position];
+        return sum;
+    }
+
+    //renumbers the live lines 1..n in recency order and rebuilds the tree with room for as many accesses again
+    void Compact()
+    {
+        std::vector<std::pair<size_t, uint64_t> > order;
+        order.reserve(lastUse.size());
+        for (std::unordered_map<uint64_t, size_t>::iterator line = lastUse.begin(); line != lastUse.end(); ++line)
+            order.push_back(std::make_pair(line->second, line->first));
+        std::sort(order.begin(), order.end());
+
+        tree.assign(std::max(2 * order.size(), size_t(MIN_TREE_SIZE)) + 1, 0); //a copy, std::max binds a reference to its arguments
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            lastUse[order[i].second] = i + 1;
+            tree[i + 1] = 1;
+        }
+        for (size_t position = 1; position < tree.size(); ++position) //linear Fenwick build
+        {
+            size_t parent = position + (position & (0 - position));
+            if (parent < tree.size())
+                tree[parent] += tree[position];
+        }
+        nextTime = order.size() + 1;
+    }
+
+    std::unordered_map<uint64_t, size_t> lastUse; //tag -> number of its last access
+    std::vector<int> tree; //Fenwick tree over access numbers, 1-based
+    size_t nextTime; //number of the next access
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Tag match kernels for the set probe.
+
+ A kernel compares the tag of a reference against every way of one set and returns a bitmask with bit n set when
+ way n is valid and holds the tag.  The tags of a set are stored contiguously as full-width 64-bit values (see
+ CacheStorage), two to a 128-bit register, so the SSE2 kernel compares a pair of ways per instruction: SSE2 has no
+ 64-bit compare, so the two 32-bit halves are compared and a tag matches when both halves do.  SSE4.1 adds the
+ 64-bit compare, and AVX2 widens it to four ways per instruction, so an 8-way set takes two.  The storage keeps at
+ least 8 readable tags after the start of every set, so the vector loads never leave the array; lanes past the
+ configured ways are discarded by the valid mask.
+
+ SelectTagMatchKernel() picks the fastest kernel the running CPU supports, with the scalar loop as the fallback.
+ The SSE4.1 and AVX2 kernels only inline into code built for those instruction sets; called out of line they lose
+ to the inlined SSE2 kernel, so auto picks AVX2 only in a build for AVX2 (e.g. -march=native) and never SSE4.1.
+ */
+
+#ifndef TAGMATCH_H
+#define TAGMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TAGMATCH_HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+typedef unsigned int (*TagMatchKernel)(const uint64_t *, unsigned char, uint64_t, size_t);
+
+//Compares one way at a time, exactly like the original probe loop
+inline unsigned int TagMatchScalar(const uint64_t *setTags, unsigned char validMask, uint64_t tag, size_t ways)
+{
+    unsigned int matches = 0;
+    for (size_t i = 0; i < ways; ++i)
+    {
+        if (setTags[i] == tag)
+            matches |= 1u << i;
+    }
+    return matches & validMask;
+}
+
+#ifdef TAGMATCH_HAVE_SSE2
+//Compares two ways per instruction
+__attribute__((target("sse2")))
+inline unsigned int TagMatchSSE2(const uint64_t *setTags, unsigned char validMask, uint64_t tag, size_t ways)
+{
+    __m128i key = _mm_set1_epi64x(static_cast<long long>(tag));
+    unsigned int matches = 0;
+    for (size_t way = 0; way < ways; way += 2)
+    {
+        __m128i tags = _mm_loadu_si128(reinterpret_cast<const __m128i *>(setTags + way));
+        __m128i halves = _mm_cmpeq_epi32(tags, key);
+        __m128i equal = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1))); //both halves of a tag
+        matches |= static_cast<unsigned int>(_mm_movemask_pd(_mm_castsi128_pd(equal))) << way; //one bit per way
+    }
+    return matches & validMask;
+}
+
+//Compares two ways per instruction with the 64-bit compare
+__attribute__((target("sse4.1")))
+inline unsigned int TagMatchSSE41(const uint64_t *setTags, unsigned char validMask, uint64_t tag, size_t ways)
+{
+    __m128i key = _mm_set1_epi64x(static_cast<long long>(tag));
+    unsigned int matches = 0;
+    for (size_t way = 0; way < ways; way += 2)
+    {
+        __m128i tags = _mm_loadu_si128(reinterpret_cast<const __m128i *>(setTags + way));
+        __m128i equal = _mm_cmpeq_epi64(tags, key);
+        matches |= static_cast<unsigned int>(_mm_movemask_pd(_mm_castsi128_pd(equal))) << way;
+    }
+    return matches & validMask;
+}
+
+//Compares four ways per instruction
+__attribute__((target("avx2")))
+inline unsigned int TagMatchAVX2(const uint64_t *setTags, unsigned char validMask, uint64_t tag, size_t ways)
+{
+    __m256i key = _mm256_set1_epi64x(static_cast<long long>(tag));
+    unsigned int matches = 0;
+    for (size_t way = 0; way < ways; way += 4)
+    {
+        __m256i tags = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(setTags + way));
+        __m256i equal = _mm256_cmpeq_epi64(tags, key);
+        matches |= static_cast<unsigned int>(_mm256_movemask_pd(_mm256_castsi256_pd(equal))) << way;
+    }
+    return matches & validMask;
+}
+#endif
+
+//Runs kernel on one set.  The built in kernels are called directly rather than through the pointer, so they
+//inline into the caller and see its number of ways when that is a constant.
+inline unsigned int RunTagMatch(TagMatchKernel kernel, const uint64_t *setTags, unsigned char validMask, uint64_t tag, size_t ways)
+{
+#ifdef TAGMATCH_HAVE_SSE2
+    if (kernel == TagMatchSSE2)
+        return TagMatchSSE2(setTags, validMask, tag, ways);
+    if (kernel == TagMatchAVX2)
+        return TagMatchAVX2(setTags, validMask, tag, ways);
+    if (kernel == TagMatchSSE41)
+        return TagMatchSSE41(setTags, validMask, tag, ways);
+#endif
+    if (kernel == TagMatchScalar)
+        return TagMatchScalar(setTags, validMask, tag, ways);
+    return kernel(setTags, validMask, tag, ways);
+}
+
+//Names accepted by SelectTagMatchKernel(); "auto" picks the best supported kernel
+inline TagMatchKernel SelectTagMatchKernel(const char *name)
+{
+    bool automatic = name == NULL || name[0] == '\0' || strcmp(name, "auto") == 0;
+#ifdef TAGMATCH_HAVE_SSE2
+#ifdef __AVX2__
+    const bool automaticAVX2 = automatic; //inlines like the SSE2 kernel and beats it from 4 ways up
+#else
+    const bool automaticAVX2 = false;
+#endif
+    if ((automatic ? automaticAVX2 : strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2"))
+        return TagMatchAVX2;
+    if (!automatic && strcmp(name, "sse4.1") == 0 && __builtin_cpu_supports("sse4.1"))
+        return TagMatchSSE41;
+    if ((automatic || strcmp(name, "sse2") == 0) && __builtin_cpu_supports("sse2"))
+        return TagMatchSSE2;
+#endif
+    if (automatic || strcmp(name, "scalar") == 0)
+        return TagMatchScalar;
+    return NULL;
+}
+
+#endif
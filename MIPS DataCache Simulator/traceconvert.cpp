@@ -0,0 +1,121 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Converts a text trace ("R:4:58" per line, or "R:4:58:core" for a multi-core trace) read from stdin into the packed
+ binary format described in tracefile.h.
+
+ Every line goes through the same mode, size and alignment checks as the simulator, with the same messages on cerr.
+ Lines that fail are dropped, so the binary file only holds references the cache model can use directly.
+
+ -------------------------------------
+ Compilation statement:
+ g++ -I. -otraceconvert.x traceconvert.cpp
+
+ Usage:
+ ./traceconvert.x trace.bin < trace.dat
+ -------------------------------------
+ */
+
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "traceparser.h"
+#include "tracefile.h"
+
+const size_t TRACE_CHUNK_SIZE = 1 << 20; //bytes read from stdin at a time
+const size_t RECORD_BATCH_SIZE = 1 << 16; //records written to the output at a time
+
+void WriteRecords(FILE *, std::vector<TraceRecord> &);
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " trace.bin < trace.dat\n";
+        return EXIT_FAILURE;
+    }
+
+    FILE *outFile = fopen(argv[1], "wb");
+    if (outFile == NULL)
+    {
+        std::cerr << "Failed to open output file " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    //header is rewritten with the final count once all records are known
+    TraceFileHeader header;
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+    header.version = TRACE_FILE_VERSION;
+    header.recordCount = 0;
+    fwrite(&header, sizeof(header), 1, outFile);
+
+    std::vector<char> chunk(TRACE_CHUNK_SIZE);
+    std::vector<TraceRecord> records;
+    records.reserve(RECORD_BATCH_SIZE);
+    TraceFields fields = {'\0', 0, 0, 0};
+    size_t carried = 0;
+    size_t lineNumber = 0;
+    bool atEnd = false;
+
+    while (!atEnd)
+    {
+        if (carried == chunk.size())
+            chunk.resize(chunk.size() * 2);
+
+        char *buffer = &chunk[0];
+        size_t bytesRead = fread(buffer + carried, 1, chunk.size() - carried, stdin);
+        char *bufferEnd = buffer + carried + bytesRead;
+        char *lineStart = buffer;
+        atEnd = (bytesRead == 0);
+
+        while (lineStart != bufferEnd)
+        {
+            char *newline = static_cast<char *>(memchr(lineStart, '\n', bufferEnd - lineStart));
+            if (newline == NULL && !atEnd)
+                break; //incomplete line, finish it with the next chunk
+            char *lineEnd = (newline == NULL) ? bufferEnd : newline;
+
+            ParseTraceLine(lineStart, lineEnd, fields.mode, fields.dataSize, fields.address, fields.core);
+            if (ValidateTraceFields(++lineNumber, fields))
+            {
+                TraceRecord record;
+                record.address = fields.address;
+                record.mode = (fields.mode == 'R' || fields.mode == 'r') ? 'R' : 'W';
+                record.dataSize = static_cast<uint8_t>(fields.dataSize);
+                record.core = static_cast<uint16_t>(fields.core);
+                records.push_back(record);
+                ++header.recordCount;
+                if (records.size() == RECORD_BATCH_SIZE)
+                    WriteRecords(outFile, records);
+            }
+            lineStart = (newline == NULL) ? lineEnd : newline + 1;
+        }
+
+        carried = bufferEnd - lineStart;
+        memmove(buffer, lineStart, carried);
+    }
+    WriteRecords(outFile, records);
+
+    fseek(outFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, outFile);
+    if (ferror(outFile) || fclose(outFile) != 0)
+    {
+        std::cerr << "Failed to write output file " << argv[1] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cerr << "Converted " << lineNumber << " lines into " << header.recordCount << " records\n";
+    return EXIT_SUCCESS;
+}
+
+//writes the buffered records and empties the buffer
+void WriteRecords(FILE *outFile, std::vector<TraceRecord> & records)
+{
+    if (!records.empty())
+        fwrite(&records[0], sizeof(TraceRecord), records.size(), outFile);
+    records.clear();
+}
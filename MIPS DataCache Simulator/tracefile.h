@@ -0,0 +1,127 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Packed binary trace format.
+
+ A binary trace is a TraceFileHeader followed by recordCount TraceRecords, all in the byte order of the machine that
+ wrote it.  Records are validated by traceconvert when the file is written, so a reader can hand them to the cache
+ model without repeating the mode, size and alignment checks.  Readers map the whole file with mmap and walk the
+ records in place.
+
+    offset  size  field
+    0       4     magic "MDCT"
+    4       4     version (TRACE_FILE_VERSION)
+    8       8     recordCount
+    16      8*n   records: address (4), mode 'R' or 'W' (1), data size (1), core (2)
+
+ The core field was reserved, and always 0, before multi-core traces; such files read as single-core traces.
+ */
+
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const char TRACE_FILE_MAGIC[4] = {'M', 'D', 'C', 'T'};
+const uint32_t TRACE_FILE_VERSION = 1;
+
+struct TraceFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t recordCount;
+};
+
+struct TraceRecord
+{
+    uint32_t address;
+    uint8_t mode;
+    uint8_t dataSize;
+    uint16_t core;
+};
+
+//A binary trace mapped into memory by MapBinaryTrace()
+struct MappedTrace
+{
+    const TraceRecord *records;
+    uint64_t recordCount;
+    void *mapping;
+    size_t mappingSize;
+};
+
+//returns TRUE if the file starts with the binary trace magic
+inline bool IsBinaryTraceFile(const char *fileName)
+{
+    char magic[sizeof(TRACE_FILE_MAGIC)];
+    FILE *traceFile = fopen(fileName, "rb");
+    if (traceFile == NULL)
+        return false;
+    bool isBinary = fread(magic, 1, sizeof(magic), traceFile) == sizeof(magic) &&
+                    memcmp(magic, TRACE_FILE_MAGIC, sizeof(magic)) == 0;
+    fclose(traceFile);
+    return isBinary;
+}
+
+//Maps a binary trace read-only and checks its header.  Exits on any error, like the rest of the simulator.
+inline void MapBinaryTrace(const char *fileName, MappedTrace & trace)
+{
+    int traceFd = open(fileName, O_RDONLY);
+    struct stat traceStat;
+    if (traceFd < 0 || fstat(traceFd, &traceStat) != 0)
+    {
+        std::cerr << "Failed to read data file.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    size_t fileSize = static_cast<size_t>(traceStat.st_size);
+    if (fileSize < sizeof(TraceFileHeader))
+    {
+        std::cerr << "Binary trace " << fileName << " is truncated.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    void *mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, traceFd, 0);
+    close(traceFd); //the mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Failed to map data file.\n";
+        exit(EXIT_FAILURE);
+    }
+    madvise(mapping, fileSize, MADV_SEQUENTIAL);
+
+    const TraceFileHeader *header = static_cast<const TraceFileHeader *>(mapping);
+    if (memcmp(header->magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0 || header->version != TRACE_FILE_VERSION)
+    {
+        std::cerr << "Binary trace " << fileName << " has an unsupported format or version.\n";
+        exit(EXIT_FAILURE);
+    }
+    if (header->recordCount != (fileSize - sizeof(TraceFileHeader)) / sizeof(TraceRecord) ||
+        (fileSize - sizeof(TraceFileHeader)) % sizeof(TraceRecord) != 0)
+    {
+        std::cerr << "Binary trace " << fileName << " is truncated.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    trace.records = reinterpret_cast<const TraceRecord *>(static_cast<const char *>(mapping) + sizeof(TraceFileHeader));
+    trace.recordCount = header->recordCount;
+    trace.mapping = mapping;
+    trace.mappingSize = fileSize;
+}
+
+inline void UnmapBinaryTrace(MappedTrace & trace)
+{
+    munmap(trace.mapping, trace.mappingSize);
+    trace.records = NULL;
+    trace.recordCount = 0;
+}
+
+#endif
@@ -0,0 +1,491 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Writes a synthetic trace of any length, as text ("R:4:58" per line) on stdout or as a binary trace (tracefile.h).
+
+    sequential      consecutive references of the data size, wrapping at the end of the footprint
+    strided         one reference every stride bytes, wrapping at the end of the footprint
+    random          uniformly random stride-sized blocks of the footprint
+    pointer-chase   every stride-sized node of the footprint once, in a random order, over and over; each node is
+                    read at its start, as a linked list walk would
+    zipf            stride-sized blocks picked with Zipf-distributed popularity (rank k is chosen in proportion to
+                    1 / k^exponent), with the popular blocks scattered over the footprint
+
+ With --cores n the references are dealt out to n cores in turn ("R:4:58:core"), each core running the pattern with
+ its own seed.  Each core works in a footprint of its own unless --shared puts them all in the same one; the
+ sequential and strided patterns then start core c at c times the data size, so neighbouring cores keep writing
+ neighbouring words of the same lines, the classic false sharing layout.
+
+ Every reference is aligned to its data size, so the simulator accepts all of them.  The generator needs constant
+ memory whatever the pattern and length: the random orders come from a keyed permutation rather than a table, and
+ Zipf ranks are drawn by rejection-inversion, so traces of 10^9 references are no harder than small ones.  The same
+ seed always gives the same trace.
+
+ -------------------------------------
+ Compilation statement:
+ g++ -O2 -I. -otracegen.x tracegen.cpp
+
+ Usage:
+ ./tracegen.x pattern references [options] > trace.dat
+ ./tracegen.x pattern references [options] --binary trace.bin
+ -------------------------------------
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <ctype.h>
+
+#include "tracefile.h"
+
+enum TracePattern
+{
+    PATTERN_SEQUENTIAL,
+    PATTERN_STRIDED,
+    PATTERN_RANDOM,
+    PATTERN_POINTER_CHASE,
+    PATTERN_ZIPF
+};
+
+const size_t OUTPUT_BUFFER_SIZE = 1 << 20; //bytes of text, or records, written at a time
+const size_t FEISTEL_ROUNDS = 4;
+
+//Generator settings, set from the command line
+TracePattern pattern;
+uint64_t referenceCount;
+uint64_t footprint = 1 << 20; //bytes of address space the trace touches
+uint64_t stride = 64; //bytes between references (strided), or per block (random, pointer-chase, zipf)
+unsigned int dataSize = 4;
+unsigned int writePercent = 30;
+double zipfExponent = 1.0;
+uint64_t seed = 1;
+unsigned int coreCount = 1;
+bool sharedFootprint = false; //every core works in the same footprint
+const char *binaryFileName = NULL;
+
+//splitmix64; small, fast and good enough for address streams
+class Random
+{
+public:
+    explicit Random(uint64_t seed)
+        : state(seed)
+    {
+    }
+
+    uint64_t Next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    //returns a value in [0, 1)
+    double Uniform()
+    {
+        return (Next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t state;
+};
+
+//A pseudo-random permutation of 0 .. size-1 that needs no table: a keyed Feistel network over the smallest even
+//number of bits that covers size, with values outside the range walked through the network again until they fit
+class Permutation
+{
+public:
+    Permutation(uint64_t size, Random & random)
+        : size(size), halfBits(1)
+    {
+        while ((uint64_t(1) << (2 * halfBits)) < size)
+            ++halfBits;
+        for (size_t round = 0; round < FEISTEL_ROUNDS; ++round)
+            keys[round] = random.Next();
+    }
+
+    uint64_t operator()(uint64_t value) const
+    {
+        do
+            value = Encrypt(value);
+        while (value >= size);
+        return value;
+    }
+
+private:
+    uint64_t Encrypt(uint64_t value) const
+    {
+        uint64_t halfMask = (uint64_t(1) << halfBits) - 1;
+        uint64_t left = value >> halfBits;
+        uint64_t right = value & halfMask;
+        for (size_t round = 0; round < FEISTEL_ROUNDS; ++round)
+        {
+            uint64_t mixed = (right ^ keys[round]) * 0xD6E8FEB86659FD93ULL;
+            uint64_t next = left ^ ((mixed ^ (mixed >> 32)) & halfMask);
+            left = right;
+            right = next;
+        }
+        return (left << halfBits) | right;
+    }
+
+    uint64_t size;
+    unsigned int halfBits;
+    uint64_t keys[FEISTEL_ROUNDS];
+};
+
+//Draws ranks 1 .. n with probability proportional to 1 / k^exponent by rejection-inversion
+//(W. Hormann and G. Derflinger, "Rejection-inversion to generate variates from monotone discrete distributions")
+class ZipfSampler
+{
+public:
+    ZipfSampler(uint64_t n, double exponent)
+        : n(n), exponent(exponent)
+    {
+        hIntegralX1 = HIntegral(1.5) - 1.0;
+        hIntegralN = HIntegral(n + 0.5);
+        s = 2.0 - HIntegralInverse(HIntegral(2.5) - H(2.0));
+    }
+
+    uint64_t Sample(Random & random) const
+    {
+        while (true)
+        {
+            double u = hIntegralN + random.Uniform() * (hIntegralX1 - hIntegralN);
+            double x = HIntegralInverse(u);
+            double k = floor(x + 0.5);
+            if (k < 1)
+                k = 1;
+            else if (k > n)
+                k = static_cast<double>(n);
+            if (k - x <= s || u >= HIntegral(k + 0.5) - H(k))
+                return static_cast<uint64_t>(k);
+        }
+    }
+
+private:
+    double H(double x) const
+    {
+        return exp(-exponent * log(x));
+    }
+
+    double HIntegral(double x) const
+    {
+        double logX = log(x);
+        return Helper2((1.0 - exponent) * logX) * logX;
+    }
+
+    double HIntegralInverse(double x) const
+    {
+        double t = x * (1.0 - exponent);
+        if (t < -1.0)
+            t = -1.0;
+        return exp(Helper1(t) * x);
+    }
+
+    //log(1 + x) / x, accurate near 0
+    static double Helper1(double x)
+    {
+        return (fabs(x) > 1e-8) ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    //(exp(x) - 1) / x, accurate near 0
+    static double Helper2(double x)
+    {
+        return (fabs(x) > 1e-8) ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    uint64_t n;
+    double exponent;
+    double hIntegralX1;
+    double hIntegralN;
+    double s;
+};
+
+void ParseArguments(int, char *[]);
+bool ParsePattern(const char *, TracePattern &);
+bool ParseNumber(const char *, uint64_t &);
+void Usage(const char *);
+void WriteTextTrace(FILE *);
+void WriteBinaryTrace(FILE *);
+void PutTextReference(std::vector<char> &, char, uint32_t, unsigned int);
+
+//Produces the references of the selected pattern for one core, one at a time
+class ReferenceStream
+{
+public:
+    explicit ReferenceStream(unsigned int core)
+        : random(seed + core * 0xD1B54A32D192ED03ULL), modeRandom((seed + core * 0xD1B54A32D192ED03ULL) ^ 0x5DEECE66DULL),
+          blocks(footprint / stride), permutation(blocks, random), zipf(blocks, zipfExponent), position(0),
+          base(sharedFootprint ? 0 : core * footprint), skew(sharedFootprint ? core * dataSize : 0)
+    {
+    }
+
+    void Next(char & mode, uint32_t & address)
+    {
+        uint64_t offset = 0;
+        switch (pattern)
+        {
+            case PATTERN_SEQUENTIAL:
+                offset = (position * dataSize + skew) % footprint;
+                break;
+            case PATTERN_STRIDED:
+                offset = ((position % blocks) * stride + skew) % footprint;
+                break;
+            case PATTERN_RANDOM:
+                offset = (random.Next() % blocks) * stride;
+                break;
+            case PATTERN_POINTER_CHASE:
+                offset = permutation(position % blocks) * stride;
+                break;
+            case PATTERN_ZIPF:
+                offset = permutation(zipf.Sample(random) - 1) * stride;
+                break;
+        }
+        ++position;
+        mode = (modeRandom.Next() % 100 < writePercent) ? 'W' : 'R';
+        address = static_cast<uint32_t>(base + offset);
+    }
+
+private:
+    Random random;
+    Random modeRandom; //kept apart so the addresses do not depend on the write percentage
+    uint64_t blocks;
+    Permutation permutation;
+    ZipfSampler zipf;
+    uint64_t position;
+    uint64_t base; //start of this core's footprint
+    uint64_t skew; //bytes this core's sequential and strided references are shifted by in a shared footprint
+};
+
+
+int main(int argc, char *argv[])
+{
+    ParseArguments(argc, argv);
+
+    if (binaryFileName == NULL)
+        WriteTextTrace(stdout);
+    else
+    {
+        FILE *outFile = fopen(binaryFileName, "wb");
+        if (outFile == NULL)
+        {
+            std::cerr << "Failed to open output file " << binaryFileName << "\n";
+            return EXIT_FAILURE;
+        }
+        WriteBinaryTrace(outFile);
+        if (ferror(outFile) || fclose(outFile) != 0)
+        {
+            std::cerr << "Failed to write output file " << binaryFileName << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+
+//Reads the pattern, the reference count and the options.  Anything unusable prints the usage and exits.
+void ParseArguments(int argc, char *argv[])
+{
+    if (argc < 3 || !ParsePattern(argv[1], pattern) || !ParseNumber(argv[2], referenceCount))
+        Usage(argv[0]);
+
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string option = argv[i];
+        uint64_t value;
+        if (i + 1 >= argc && option != "--shared")
+            Usage(argv[0]);
+        else if (option == "--footprint" && ParseNumber(argv[i + 1], value))
+            footprint = value;
+        else if (option == "--stride" && ParseNumber(argv[i + 1], value))
+            stride = value;
+        else if (option == "--size" && ParseNumber(argv[i + 1], value))
+            dataSize = static_cast<unsigned int>(value);
+        else if (option == "--writes" && ParseNumber(argv[i + 1], value) && value <= 100)
+            writePercent = static_cast<unsigned int>(value);
+        else if (option == "--zipf" && strtod(argv[i + 1], NULL) > 0)
+            zipfExponent = strtod(argv[i + 1], NULL);
+        else if (option == "--seed" && ParseNumber(argv[i + 1], value))
+            seed = value;
+        else if (option == "--cores" && ParseNumber(argv[i + 1], value) && value >= 1 && value <= 64)
+            coreCount = static_cast<unsigned int>(value);
+        else if (option == "--shared")
+        {
+            sharedFootprint = true;
+            continue; //takes no value
+        }
+        else if (option == "--binary")
+            binaryFileName = argv[i + 1];
+        else
+            Usage(argv[0]);
+        ++i;
+    }
+
+    if (dataSize != 1 && dataSize != 2 && dataSize != 4 && dataSize != 8)
+    {
+        std::cerr << "The data size must be 1, 2, 4 or 8 bytes\n";
+        exit(EXIT_FAILURE);
+    }
+    if (stride == 0 || stride % dataSize != 0 || footprint < stride || footprint > (uint64_t(1) << 32))
+    {
+        std::cerr << "The stride must be a multiple of the data size, and the footprint from one stride to 4 GiB\n";
+        exit(EXIT_FAILURE);
+    }
+    footprint -= footprint % stride; //whole blocks only, so wrapping keeps every reference aligned
+    if (!sharedFootprint && footprint * coreCount > (uint64_t(1) << 32))
+    {
+        std::cerr << "The footprints of all cores must fit in 4 GiB; use a smaller footprint or --shared\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+bool ParsePattern(const char *name, TracePattern & result)
+{
+    const char *names[] = {"sequential", "strided", "random", "pointer-chase", "zipf"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            result = static_cast<TracePattern>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+//Reads a decimal count; 1e9 style exponents and k, M, G suffixes (powers of 1024) are accepted for convenience
+bool ParseNumber(const char *text, uint64_t & value)
+{
+    char *end;
+    double number = strtod(text, &end);
+    if (end == text || number < 0)
+        return false;
+    const char *suffixes = "KMG";
+    const char *suffix = (*end != '\0') ? strchr(suffixes, toupper(*end)) : NULL;
+    if (suffix != NULL)
+    {
+        number *= pow(1024.0, static_cast<double>(suffix - suffixes + 1));
+        ++end;
+    }
+    if (*end != '\0')
+        return false;
+    value = static_cast<uint64_t>(number);
+    return true;
+}
+
+
+void Usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " pattern references [options] > trace.dat\n";
+    std::cerr << "   pattern             sequential, strided, random, pointer-chase or zipf\n";
+    std::cerr << "   references          how many to write, e.g. 1000000 or 1e9\n";
+    std::cerr << "   --footprint bytes   address space covered, up to 4G (default 1M)\n";
+    std::cerr << "   --stride bytes      stride, or block size for random, pointer-chase and zipf (default 64)\n";
+    std::cerr << "   --size bytes        data size of every reference: 1, 2, 4 or 8 (default 4)\n";
+    std::cerr << "   --writes percent    share of references that are writes (default 30)\n";
+    std::cerr << "   --zipf exponent     skew of the zipf pattern, above 0 (default 1.0)\n";
+    std::cerr << "   --seed n            seed of the random patterns and of the reads and writes (default 1)\n";
+    std::cerr << "   --cores n           deal the references out to n cores, 1 to 64, each with its own stream (default 1)\n";
+    std::cerr << "   --shared            put every core in the same footprint instead of one footprint each\n";
+    std::cerr << "   --binary file       write a binary trace to file instead of text to stdout\n";
+    exit(EXIT_FAILURE);
+}
+
+
+//Writes the trace as text, formatted by hand into a large buffer
+void WriteTextTrace(FILE *outFile)
+{
+    std::vector<ReferenceStream> streams;
+    for (unsigned int core = 0; core < coreCount; ++core)
+        streams.push_back(ReferenceStream(core));
+    std::vector<char> buffer;
+    buffer.reserve(OUTPUT_BUFFER_SIZE + 32);
+    for (uint64_t i = 0; i < referenceCount; ++i)
+    {
+        char mode;
+        uint32_t address;
+        unsigned int core = static_cast<unsigned int>(i % coreCount);
+        streams[core].Next(mode, address);
+        PutTextReference(buffer, mode, address, core);
+        if (buffer.size() >= OUTPUT_BUFFER_SIZE)
+        {
+            fwrite(&buffer[0], 1, buffer.size(), outFile);
+            buffer.clear();
+        }
+    }
+    if (!buffer.empty())
+        fwrite(&buffer[0], 1, buffer.size(), outFile);
+    fflush(outFile);
+}
+
+
+//Appends one "mode:size:address" line, the address in hex as the sample traces have it, with ":core" after it when
+//there is more than one core
+void PutTextReference(std::vector<char> & buffer, char mode, uint32_t address, unsigned int core)
+{
+    char line[32];
+    char *end = line + sizeof(line);
+    char *text = end;
+    *--text = '\n';
+    if (coreCount > 1)
+    {
+        do
+        {
+            *--text = static_cast<char>('0' + core % 10);
+            core /= 10;
+        } while (core != 0);
+        *--text = ':';
+    }
+    do
+    {
+        *--text = "0123456789abcdef"[address & 0xF];
+        address >>= 4;
+    } while (address != 0);
+    *--text = ':';
+    *--text = static_cast<char>('0' + dataSize);
+    *--text = ':';
+    *--text = mode;
+    buffer.insert(buffer.end(), text, end);
+}
+
+
+//Writes the trace in the binary format; the record count is known up front
+void WriteBinaryTrace(FILE *outFile)
+{
+    TraceFileHeader header;
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+    header.version = TRACE_FILE_VERSION;
+    header.recordCount = referenceCount;
+    fwrite(&header, sizeof(header), 1, outFile);
+
+    std::vector<ReferenceStream> streams;
+    for (unsigned int core = 0; core < coreCount; ++core)
+        streams.push_back(ReferenceStream(core));
+    std::vector<TraceRecord> records;
+    records.reserve(OUTPUT_BUFFER_SIZE / sizeof(TraceRecord));
+    for (uint64_t i = 0; i < referenceCount; ++i)
+    {
+        char mode;
+        TraceRecord record;
+        record.core = static_cast<uint16_t>(i % coreCount);
+        streams[record.core].Next(mode, record.address);
+        record.mode = static_cast<uint8_t>(mode);
+        record.dataSize = static_cast<uint8_t>(dataSize);
+        records.push_back(record);
+        if (records.size() == records.capacity())
+        {
+            fwrite(&records[0], sizeof(TraceRecord), records.size(), outFile);
+            records.clear();
+        }
+    }
+    if (!records.empty())
+        fwrite(&records[0], sizeof(TraceRecord), records.size(), outFile);
+}
@@ -0,0 +1,181 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Hand written parser for "R:4:58" trace lines, with an optional fourth field naming the core that made the
+ reference in a multi-core trace ("R:4:58:3").  A line without it belongs to core 0.
+
+ Replaces the per-line sscanf(line,"%c:%d:%x",...) call.  It works directly on a byte range so the caller does not need
+ to copy the line or terminate it, performs no locale handling and never allocates.  The field rules follow the sscanf
+ format it replaces so that existing traces produce the same references and the same error lines:
+
+    %c   any single character
+    :    a literal colon, no whitespace skipped
+    %d   optional leading whitespace, optional sign, decimal digits
+    :    a literal colon, no whitespace skipped
+    %x   optional leading whitespace, optional sign, optional 0x prefix, hex digits
+    :%u  optional: a literal colon and decimal digits, the core
+
+ Parsing stops at the first field that does not match and the remaining fields are left untouched, except the core,
+ which is 0 whenever the address parses and no core follows it.
+ */
+
+#ifndef TRACEPARSER_H
+#define TRACEPARSER_H
+
+#include <iostream>
+#include <stdlib.h>
+
+//Holds the fields read from one trace line
+struct TraceFields
+{
+    char mode;
+    unsigned int dataSize;
+    unsigned int address;
+    unsigned int core; //0 unless the trace names cores
+};
+
+//returns the value of a hex digit, or 16 or more if the character is not one
+inline unsigned int HexDigitValue(const unsigned char c)
+{
+    unsigned int digit = c - '0';
+    if (digit < 10)
+        return digit;
+    unsigned int letter = (c | 0x20) - 'a'; //folds upper case to lower case; anything below 'a' wraps to a large value
+    if (letter < 6)
+        return letter + 10;
+    return 16;
+}
+
+//returns TRUE for the characters sscanf treats as whitespace in the "C" locale
+inline bool IsTraceSpace(const char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+//Parses the line in [begin,end).  Returns the number of fields assigned (0 to 4), like sscanf.
+inline int ParseTraceLine(const char *begin, const char *end, char & mode, unsigned int & dataSize, unsigned int & address,
+                          unsigned int & core)
+{
+    const char *p = begin;
+
+    //mode
+    if (p == end)
+        return 0;
+    mode = *p++;
+
+    //data size
+    if (p == end || *p != ':')
+        return 1;
+    ++p;
+    while (p != end && IsTraceSpace(*p))
+        ++p;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    if (p == end || static_cast<unsigned int>(*p - '0') >= 10)
+        return 1;
+    unsigned int value = 0;
+    while (p != end && static_cast<unsigned int>(*p - '0') < 10)
+        value = value * 10 + static_cast<unsigned int>(*p++ - '0');
+    dataSize = negative ? (0u - value) : value;
+
+    //address
+    if (p == end || *p != ':')
+        return 2;
+    ++p;
+    while (p != end && IsTraceSpace(*p))
+        ++p;
+    negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    if ((end - p) > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && HexDigitValue(p[2]) < 16)
+        p += 2; //skip the 0x prefix
+    if (p == end || HexDigitValue(*p) >= 16)
+        return 2;
+    value = 0;
+    unsigned int digit;
+    while (p != end && (digit = HexDigitValue(*p)) < 16)
+    {
+        value = (value << 4) | digit;
+        ++p;
+    }
+    address = negative ? (0u - value) : value;
+
+    //core
+    core = 0;
+    if (p == end || *p != ':' || p + 1 == end || static_cast<unsigned int>(p[1] - '0') >= 10)
+        return 3;
+    ++p;
+    value = 0;
+    while (p != end && static_cast<unsigned int>(*p - '0') < 10)
+        value = value * 10 + static_cast<unsigned int>(*p++ - '0');
+    core = value;
+
+    return 4;
+}
+
+//checks to see if there is a problem with the input based on configuration properties.
+
+inline void ModeValidityCheck(const char mode)
+{
+    if (mode != 'R' && mode != 'W' && mode != 'r' && mode != 'w')
+    {
+        std::cerr << "Mode is invalid.  Exiting.\n";
+        exit(EXIT_FAILURE);
+    }
+}
+
+//returns TRUE if there is an error with the data size
+inline bool SizeCheck(const unsigned int size)
+{
+    bool sizeError = 0; //set default to no problem
+    if (size != 1 && size != 2 && size != 4 && size != 8)
+    {
+        sizeError = 1;
+    }
+    return sizeError;
+}
+
+//returns TRUE if there is an error with the alignment
+inline bool AlignmentCheck(const unsigned int size, const unsigned int address)
+{
+    //if size is not multiple of the address then error
+    if ((address % size) != 0)
+        return 1;
+    else
+        return 0;
+}
+
+//returns TRUE if the reference passes the checks of ValidateTraceFields(), without reporting anything
+inline bool TraceFieldsValid(const TraceFields & fields)
+{
+    return (fields.mode == 'R' || fields.mode == 'W' || fields.mode == 'r' || fields.mode == 'w') &&
+           !SizeCheck(fields.dataSize) && !AlignmentCheck(fields.dataSize, fields.address);
+}
+
+//Runs the mode, size and alignment checks on one reference.  Reports a problem on cerr using the 1-based
+//line number and returns FALSE if the reference has to be skipped.  An invalid mode exits the program.
+//unit names what lineNumber counts in the message, "record" for a binary trace.
+inline bool ValidateTraceFields(const size_t lineNumber, const TraceFields & fields, const char *unit = "line")
+{
+    //check if mode is 'R' or 'W', exit otherwise
+    ModeValidityCheck(fields.mode);
+    
+    //check if data size is 1,2,4, or 8
+    if (SizeCheck(fields.dataSize))
+    {
+        std::cerr << unit << " " << lineNumber << " has illegal size " << fields.dataSize << "\n";
+        return false;
+    }
+    
+    if (AlignmentCheck(fields.dataSize, fields.address))
+    {
+        std::cerr << unit << " " << lineNumber << " has misaligned reference at address " << std::hex << fields.address << " for size " <<
+            std::dec << fields.dataSize << "\n";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ Andrew J Wood
+ CDA3101 Project 6 - MIPS DataCache Simulator
+
+ Write-combining buffer between the data cache and the level below it.
+
+ Lines written out of the data cache (dirty victims and stores that write through or around it) wait in a small
+ FIFO of line addresses instead of going below at once.  A write to a line that is already waiting merges with it
+ and costs nothing; when a new line finds the buffer full, the oldest line is drained to the level below.  Each
+ entry also carries the sectors written, so a sectored cache drains only those.  The counters show how much write
+ traffic the buffer absorbed.
+ */
+
+#ifndef WRITEBUFFER_H
+#define WRITEBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class WriteBuffer
+{
+public:
+    WriteBuffer()
+    {
+        Resize(0);
+    }
+
+    //empties the buffer and sets its number of entries; 0 means there is no buffer
+    void Resize(size_t entries)
+    {
+        lines.assign(entries, 0);
+        sectors.assign(entries, 0);
+        head = 0;
+        count = 0;
+        writeCounter = 0;
+        combineCounter = 0;
+        drainCounter = 0;
+    }
+
+    size_t Entries() const
+    {
+        return lines.size();
+    }
+
+    //Adds a write of lineSectors of the line at lineAddress.  Returns TRUE and sets drainedLine and drainedSectors
+    //if the oldest line had to leave to make room; that line must be written to the level below.
+    bool Add(uint64_t lineAddress, unsigned int lineSectors, uint64_t & drainedLine, unsigned int & drainedSectors)
+    {
+        ++writeCounter;
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t entry = (head + i) % lines.size();
+            if (lines[entry] == lineAddress)
+            {
+                sectors[entry] |= lineSectors;
+                ++combineCounter;
+                return false;
+            }
+        }
+
+        bool drained = false;
+        if (count == lines.size())
+            drained = Drain(drainedLine, drainedSectors);
+        lines[(head + count) % lines.size()] = lineAddress;
+        sectors[(head + count) % lines.size()] = lineSectors;
+        ++count;
+        return drained;
+    }
+
+    //removes the oldest line into lineAddress and lineSectors; returns FALSE if the buffer is empty
+    bool Drain(uint64_t & lineAddress, unsigned int & lineSectors)
+    {
+        if (count == 0)
+            return false;
+        lineAddress = lines[head];
+        lineSectors = sectors[head];
+        head = (head + 1) % lines.size();
+        --count;
+        ++drainCounter;
+        return true;
+    }
+
+    size_t Writes() const
+    {
+        return writeCounter;
+    }
+
+    size_t Combined() const
+    {
+        return combineCounter;
+    }
+
+    size_t Drained() const
+    {
+        return drainCounter;
+    }
+
+private:
+    std::vector<uint64_t> lines; //ring of waiting line addresses, oldest at head
+    std::vector<unsigned int> sectors; //sectors written of each waiting line
+    size_t head;
+    size_t count;
+    size_t writeCounter; //writes offered to the buffer
+    size_t combineCounter; //writes merged with a waiting line
+    size_t drainCounter; //lines written to the level below
+};
+
+#endif